@@ -31,6 +31,7 @@
 #define FIXEDVECTOR_HPP 1
 
 #include "CXXR/VectorBase.h"
+#include "CXXR/MappedFile.hpp"
 #include "CXXR/MemoryBank.hpp"
 
 namespace CXXR {
@@ -77,6 +78,23 @@ namespace CXXR {
 	 */
 	static FixedVector* create(size_type sz);
 
+	/** @brief Create a vector whose data lie in a mapped file.
+	 *
+	 * The vector uses the mapped memory as its data block instead
+	 * of allocating one, and holds a reference to \a file until it
+	 * is destroyed.  Only available for element types that need no
+	 * construction or destruction.
+	 *
+	 * @param sz Number of elements.
+	 *
+	 * @param data Start of the elements within the mapping of \a
+	 *          file, suitably aligned for T.
+	 *
+	 * @param file The MappedFile containing the data.
+	 */
+	static FixedVector* createMapped(size_type sz, T* data,
+					 MappedFile* file);
+
 	/** @brief Create a vector from a range.
 	 * 
 	 * @tparam An iterator type, at least a forward iterator.
@@ -209,6 +227,11 @@ namespace CXXR {
 	 */
 	~FixedVector()
 	{
+	    if (m_data != reinterpret_cast<T*>(m_first_element_storage)) {
+		// Data block is in a MappedFile; see createMapped().
+		MappedFile::release(m_data);
+		return;
+	    }
 	    destructElementsIfNeeded();
 
 	    // GCNode::~GCNode doesn't know about the string storage space in
@@ -245,6 +268,13 @@ namespace CXXR {
 	 */
 	FixedVector(const FixedVector<T, ST, Initializer>& pattern);
 
+	// Constructor used by createMapped().
+	FixedVector(size_type sz, T* data)
+	    : VectorBase(ST, sz), m_data(data)
+	{
+	    Initializer::initialize(this);
+	}
+
 	FixedVector& operator=(const FixedVector&) = delete;
 
 	static void* allocate(size_type size);
@@ -338,6 +368,19 @@ CXXR::FixedVector<T, ST, Initr>::create(size_type sz)
     return new(storage) FixedVector(sz);
 }
 
+template <typename T, SEXPTYPE ST, typename Initr>
+CXXR::FixedVector<T, ST, Initr>*
+CXXR::FixedVector<T, ST, Initr>::createMapped(size_type sz, T* data,
+					      MappedFile* file)
+{
+    static_assert(!ElementTraits::MustConstruct<T>::value
+		  && !ElementTraits::MustDestruct<T>::value,
+		  "mapped vectors require trivial element types");
+    void* storage = GCNode::operator new(sizeof(FixedVector));
+    file->incRef();
+    return new(storage) FixedVector(sz, data);
+}
+
 template <typename T, SEXPTYPE ST, typename Initr>
 CXXR::FixedVector<T, ST, Initr>* CXXR::FixedVector<T, ST, Initr>::clone() const
 {
@@ -380,8 +423,10 @@ void CXXR::FixedVector<T, ST, Initr>::decreaseSizeInPlace(size_type new_size)
     if (new_size > size()) {
 	Rf_error("Increasing vector length in place not allowed.");
     }
-    size_t bytes = (size() - new_size) * sizeof(T);
-    MemoryBank::adjustBytesAllocated(-bytes);
+    if (m_data == reinterpret_cast<T*>(m_first_element_storage)) {
+	size_t bytes = (size() - new_size) * sizeof(T);
+	MemoryBank::adjustBytesAllocated(-bytes);
+    }
 
     destructElementsIfNeeded(begin() + new_size, end());
     adjustSize(new_size);
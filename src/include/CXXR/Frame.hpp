@@ -717,6 +717,19 @@ namespace CXXR {
 	    return old;
 	}
 
+	/** @brief Prepare to hold a given number of Bindings.
+	 *
+	 * This is a hint that the Frame will shortly contain \a n
+	 * Bindings, so that an implementation can size its storage
+	 * once rather than growing it repeatedly as Bindings are
+	 * added.  The default implementation does nothing.
+	 *
+	 * @param n Number of Bindings the Frame is expected to
+	 *          contain, including any it already contains.
+	 */
+	virtual void reserve(std::size_t n)
+	{}
+
 	/** @brief Number of Bindings in Frame.
 	 *
 	 * @return the number of Symbols for which Bindings exist in
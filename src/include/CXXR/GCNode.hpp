@@ -206,6 +206,22 @@ namespace CXXR {
 	 */
 	static void gc(bool markSweep);
 
+	/** @brief Freeze every existing node.
+	 *
+	 * Intended to be called in a process just created by fork(),
+	 * whose heap pages are shared copy-on-write with the parent
+	 * process.  Thereafter the nodes already in existence are
+	 * never written to: their reference counts and stack bits are
+	 * no longer updated, the mark phase of garbage collection
+	 * records their visits in a side table, and they are never
+	 * deleted.  New nodes are allocated in new heap blocks, and
+	 * are managed as usual.
+	 *
+	 * This is a no-op in builds using the address sanitizer, and
+	 * subsequent calls do nothing.
+	 */
+	static void freezeHeap();
+
 	/** @brief Number of GCNode objects in existence.
 	 *
 	 * @return the number of GCNode objects currently in
@@ -291,6 +307,18 @@ namespace CXXR {
 	// their reference count drops to zero if their stack bit is unset.
 	static bool s_on_stack_bits_correct;
 
+	// Set by freezeHeap().
+	static bool s_heap_frozen;
+
+	// Is this node frozen by freezeHeap()?  Only meaningful if
+	// s_heap_frozen is set.
+	bool isFrozen() const;
+
+	bool isWritable() const
+	{
+	    return !s_heap_frozen || !isFrozen();
+	}
+
 	// Bit patterns XORd into m_rcmms to decrement or increment the
 	// reference count.  Patterns 0, 2, 4, ... are used to
 	// decrement; 1, 3, 5, .. to increment.
@@ -355,7 +383,7 @@ namespace CXXR {
 	// zero, mark the node as moribund.
 	static void decRefCount(const GCNode* node)
 	{
-	    if (node) {
+	    if (node && node->isWritable()) {
 		unsigned char& rcmms = node->m_rcmms;
 		rcmms ^= s_decinc_refcount[rcmms & s_refcount_mask];
 		if ((rcmms &
@@ -365,10 +393,13 @@ namespace CXXR {
 	}
 
 	void setOnStackBit() const {
-	    m_rcmms |= s_on_stack_mask;
+	    if (isWritable())
+		m_rcmms |= s_on_stack_mask;
 	}
 
 	void clearOnStackBit() const {
+	    if (!isWritable())
+		return;
 	    m_rcmms = m_rcmms & static_cast<unsigned char>(~s_on_stack_mask);
 	    if ((m_rcmms &
 		 (s_refcount_mask | s_on_stack_mask| s_moribund_mask)) == 0)
@@ -393,7 +424,7 @@ namespace CXXR {
 	// stickiness of the MSB.
 	static void incRefCount(const GCNode* node)
 	{
-	    if (node) {
+	    if (node && node->isWritable()) {
 		unsigned char& rcmms = node->m_rcmms;
 		rcmms ^= s_decinc_refcount[(rcmms & s_refcount_mask) + 1];
 	    }
@@ -408,9 +439,10 @@ namespace CXXR {
 	static void initialize();
 	friend void initializeMemorySubsystem();
 
+	// Frozen nodes count as marked, so they are never collected.
 	bool isMarked() const
 	{
-	    return (m_rcmms & s_mark_mask) == s_mark;
+	    return (m_rcmms & s_mark_mask) == s_mark || !isWritable();
 	}
 
 	// Mark this node as moribund:
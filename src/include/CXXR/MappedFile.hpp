@@ -0,0 +1,116 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the CXXR Project Authors.
+ *
+ *  CXXR is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the CXXR website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file MappedFile.hpp
+ *
+ * @brief Class CXXR::MappedFile
+ */
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+
+namespace CXXR {
+    /** @brief A file mapped into memory to serve as vector storage.
+     *
+     * The file is mapped privately and writably, so its pages are
+     * shared (through the page cache) with every other process
+     * mapping the same file until they are modified, and a
+     * modification is never written back to the file but gives the
+     * process its own copy of the page.
+     *
+     * A FixedVector may use a region of the mapping as its data block
+     * (see FixedVector::createMapped()).  Each such vector holds a
+     * reference to the MappedFile, as does whoever opened it, and the
+     * file is unmapped when the last reference is dropped.
+     *
+     * Mapping is not supported on Windows, where open() raises an
+     * error.
+     */
+    class MappedFile {
+    public:
+	/** @brief Map a file.
+	 *
+	 * Raises an R error if the file cannot be opened or mapped.
+	 *
+	 * @param path Name of the file, already expanded.
+	 *
+	 * @return Pointer to the mapping, with a reference count of
+	 * one held by the caller.
+	 */
+	static MappedFile* open(const char* path);
+
+	/** @brief Start of the mapping.
+	 */
+	char* data() const
+	{
+	    return m_data;
+	}
+
+	/** @brief Size of the file in bytes.
+	 */
+	size_t size() const
+	{
+	    return m_size;
+	}
+
+	/** @brief Add a reference to the mapping.
+	 */
+	void incRef()
+	{
+	    ++m_refcount;
+	}
+
+	/** @brief Drop a reference to the mapping.
+	 *
+	 * The file is unmapped and this object deleted when the
+	 * reference count falls to zero.
+	 */
+	void decRef();
+
+	/** @brief Drop the reference held by a vector.
+	 *
+	 * @param p Pointer into the mapped region of some MappedFile,
+	 *          in practice the data block of a vector created by
+	 *          FixedVector::createMapped().  Drops one reference to
+	 *          that MappedFile.
+	 */
+	static void release(const void* p);
+    private:
+	char* m_data;
+	size_t m_size;
+	unsigned int m_refcount;
+
+	MappedFile(char* data, size_t size)
+	    : m_data(data), m_size(size), m_refcount(1)
+	{}
+
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+    };
+}  // namespace CXXR
+
+#endif  // MAPPEDFILE_HPP
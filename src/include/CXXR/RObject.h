@@ -77,6 +77,10 @@ namespace CXXR {
      * <li><tt>m_has_class</tt> is true iff the object has the class
      * attribute.</li>
      *
+     * <li>Similarly <tt>m_has_names</tt>, <tt>m_has_dim</tt> and
+     * <tt>m_has_dimnames</tt> are true iff the object has respectively
+     * the names, dim and dimnames attribute.</li>
+     *
      * <li>Each attribute in the list of attributes must have a Symbol
      * as its tag.  Null tags are not allowed.</li>
      *
@@ -298,6 +302,37 @@ namespace CXXR {
 	    return m_type & s_class_mask;
 	}
 
+	/** @brief Has this object the dim attribute?
+	 *
+	 * @return true iff this object has the dim attribute.
+	 */
+	bool hasDim() const
+	{
+	    return m_has_dim;
+	}
+
+	/** @brief Has this object the dimnames attribute?
+	 *
+	 * @return true iff this object has the dimnames attribute.
+	 */
+	bool hasDimNames() const
+	{
+	    return m_has_dimnames;
+	}
+
+	/** @brief Has this object the names attribute?
+	 *
+	 * @return true iff this object has the names attribute.
+	 *
+	 * @note The names of a pairlist or a language object are
+	 * usually held in the tags of its cells rather than in an
+	 * attribute, and are not reported by this function.
+	 */
+	bool hasNames() const
+	{
+	    return m_has_names;
+	}
+
 	/** @brief Is this an S4 object?
 	 *
 	 * @return true iff this is an S4 object.
@@ -534,7 +569,8 @@ namespace CXXR {
 	explicit RObject(SEXPTYPE stype = CXXSXP)
 	    : m_type(stype & s_sexptype_mask), m_named(0),
 	      m_memory_traced(false), m_missing(0), m_argused(0),
-	      m_active_binding(false), m_binding_locked(false)
+	      m_active_binding(false), m_binding_locked(false),
+	      m_has_names(false), m_has_dim(false), m_has_dimnames(false)
 	{}
 
 	/** @brief Copy constructor.
@@ -593,8 +629,26 @@ namespace CXXR {
 	bool m_active_binding : 1;
 	bool m_binding_locked : 1;
     private:
+	// Each of the following is set iff the object has the
+	// attribute with the corresponding name.  They allow lookups
+	// of these frequently consulted attributes to be answered
+	// without scanning m_attrib in the common case that the
+	// attribute is absent.
+	bool m_has_names      : 1;
+	bool m_has_dim        : 1;
+	bool m_has_dimnames   : 1;
+
 	GCEdge<PairList> m_attrib;
 
+	// Update the flags above to reflect the fact that the
+	// attribute named \a name is being set (if \a present is true)
+	// or removed.
+	void noteAttribute(const Symbol* name, bool present);
+
+	// Return false if the object definitely does not have the
+	// attribute named \a name.
+	bool mayHaveAttribute(const Symbol* name) const;
+
 #ifdef R_MEMORY_PROFILING
 	// This function implements maybeTraceMemory() (qv.) when
 	// memory profiling is enabled.
@@ -73,6 +73,7 @@ namespace CXXR {
 	    const override;
 	StdFrame* clone() const override;
 	void lockBindings() override;
+	void reserve(std::size_t n) override;
 	std::size_t size() const override;
     private:
 	map m_map;
@@ -45,6 +45,8 @@ typedef enum {
 
 #ifdef __cplusplus
 
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
 #include <string>
 
@@ -168,6 +170,69 @@ namespace CXXR {
 	    return m_ascii;
 	}
 
+	/** @name UTF-8 metadata
+	 *
+	 * Facts about the text of the String read as UTF-8, worked
+	 * out in one pass on first request and kept with the String,
+	 * so that repeated character-level operations on it do not
+	 * decode it again.  They are meaningful only if the String is
+	 * in UTF-8, or is native in a UTF-8 locale.  Widths depend on
+	 * the locale, so all are recomputed after localeChanged().
+	 */
+	//@{
+	/** @brief Is the text valid UTF-8?
+	 */
+	bool utf8Valid() const;
+
+	/** @brief Number of UTF-8 characters.
+	 *
+	 * An invalid byte counts as one character.
+	 */
+	int utf8Chars() const;
+
+	/** @brief Display width of the text.
+	 *
+	 * @return The sum of Ri18n_wcwidth() over the characters,
+	 * which may include -1 for nonprinting ones.  If the text is
+	 * not valid UTF-8 each character counts as width 1.
+	 */
+	int utf8Width() const;
+
+	/** @brief Does the text contain a nonprinting character?
+	 *
+	 * @return true iff Ri18n_wcwidth() is -1 for some character,
+	 * in which case Ri18n_wcswidth() of the text is -1.
+	 */
+	bool utf8HasNonprinting() const;
+
+	/** @brief Byte offset of a character.
+	 *
+	 * Long strings keep an index of the offset of every 32nd
+	 * character, so this takes time independent of \a n.
+	 *
+	 * @param n Index of the required character (counting from
+	 *          zero).  Must be nonnegative.
+	 *
+	 * @return the offset of character \a n, or size() if the text
+	 * has no more than \a n characters.
+	 */
+	std::size_t utf8Offset(int n) const;
+	//@}
+
+	/** @brief Hash of the text.
+	 *
+	 * @return a 64-bit hash of the text translated to UTF-8, so
+	 * that Strings with the same text in different encodings hash
+	 * alike.  It is cached for non-ASCII Strings.
+	 */
+	std::uint64_t hash() const;
+
+	/** @brief Discard metadata which depends on the locale.
+	 *
+	 * To be called when LC_CTYPE changes.
+	 */
+	static void localeChanged();
+
 	/** @brief Test if 'not available'.
 	 *
 	 * @return true iff this is the 'not available' string.
@@ -218,6 +283,26 @@ namespace CXXR {
 	static String* obtain(const std::string& str,
 			      cetype_t encoding = CE_NATIVE);
 
+	/** @brief Get a pointer to a String object, perhaps known
+	 * to be ASCII.
+	 *
+	 * As the two-argument form, for callers which build a string
+	 * from parts whose ASCII-ness is already known.
+	 *
+	 * @param str The text of the required String.
+	 *
+	 * @param encoding The encoding of the required String.
+	 *
+	 * @param ascii true if \a str is known to contain only ASCII
+	 *          characters, in which case it is not scanned.  If
+	 *          false, this is determined.
+	 *
+	 * @return Pointer to a String (preexisting or newly created)
+	 * representing the specified text in the specified encoding.
+	 */
+	static String* obtain(const std::string& str, cetype_t encoding,
+			      bool ascii);
+
 	/** @brief The name by which this type is known in R.
 	 *
 	 * @return the name by which this type is known in R.
@@ -289,6 +374,14 @@ namespace CXXR {
 	  // by this String, or a null pointer if none.
 	bool m_ascii;
 
+	// Lazily computed UTF-8 metadata, defined in String.cpp:
+	struct Metadata;
+	mutable std::unique_ptr<Metadata> m_metadata;
+	static unsigned int s_locale_epoch;
+
+	Metadata& metadata() const;
+	const Metadata& utf8Metadata() const;
+
         // Should only be called by String::create().
         String(char* character_storage,
                const std::string& text, cetype_t encoding, bool isAscii);
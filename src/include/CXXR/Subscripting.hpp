@@ -452,6 +452,15 @@ namespace CXXR {
 	    {
 		return m_min_lhssize;
 	    }
+
+	    /** @brief Do the indices form a contiguous ascending range?
+	     *
+	     * @return true iff this Indices vector is non-empty and
+	     * consists of the values <tt>k, k+1, ..., k+n-1</tt> for
+	     * some k >= 1 (so in particular contains no NA zeroes).
+	     * The scan stops at the first element out of sequence.
+	     */
+	    bool isContiguous() const;
 	private:
 	    /* All the elements of this ListVector are
 	     * NULL, except where the corresponding element of \a
@@ -1044,6 +1053,28 @@ namespace CXXR {
 	// ***** FIXME *****  Currently needed because Handle's
 	// assignment operator takes a non-const RHS:
 	V* vnc = const_cast<V*>(v);
+	if (indices.maximumIndex() <= vsize) {
+	    // No index is out of range, so only NAs need checking,
+	    // and a contiguous range (e.g. x[m:n], x[-1] or a mask
+	    // selecting a run of elements) is a straight block copy:
+	    typename V::iterator out = ans->begin();
+	    if (indices.isContiguous()) {
+		typename V::iterator in = vnc->begin() + (indices[0] - 1);
+		for (std::size_t i = 0; i < ni; ++i)
+		    out[i] = ElementTraits::duplicate_element(in[i]);
+	    } else {
+		for (std::size_t i = 0; i < ni; ++i) {
+		    std::size_t index = indices[i];
+		    if (index == 0)
+			out[i] = ElementTraits::duplicate_element(
+			    NA<typename V::value_type>());
+		    else out[i] = ElementTraits::duplicate_element(
+			    (*vnc)[index - 1]);
+		}
+	    }
+	    setVectorAttributes(ans, v, indices);
+	    return ans;
+	}
 	for (std::size_t i = 0; i < ni; ++i) {
 	    std::size_t index = indices[i];
 	    // Note that zero and negative indices ought not to occur.
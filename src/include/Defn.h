@@ -455,6 +455,7 @@ extern int Rf_initEmbeddedR(int argc, char **argv);
 
 extern const char	*R_GUIType	INI_as("unknown");
 extern Rboolean R_isForkedChild		INI_as(FALSE); /* was this forked? */
+void R_FreezeHeap(void); /* in a forked child */
 
 extern0 double cpuLimit			INI_as(-1.0);
 extern0 double cpuLimit2	       	INI_as(-1.0);
@@ -902,6 +903,11 @@ const char *Rf_EncodeReal2(double, int, int, int);
 const char *Rf_EncodeChar(SEXP);
 
 
+/* main/apply.c */
+SEXP R_vectorElement(SEXP x, R_xlen_t i);
+SEXP R_invokeClosure(const CXXR::Closure* closure, CXXR::Expression* call,
+		     CXXR::PairList* promargs, CXXR::Environment* rho);
+
 /* main/sort.c */
 void orderVector1(int *indx, int n, SEXP key, Rboolean nalast,
 		  Rboolean decreasing, SEXP rho);
@@ -950,6 +956,7 @@ SEXP fixup_NaRm(SEXP args); /* summary.c */
 void invalidate_cached_recodings(void);  /* from sysutils.c */
 void resetICUcollator(void); /* from util.c */
 void dt_invalidate_locale(); /* from Rstrptime.h */
+void R_ClearRegexCache(void); /* from grep.c */
 extern int R_OutputCon; /* from connections.c */
 extern int R_InitReadItemDepth, R_ReadItemDepth; /* from serialize.c */
 void get_current_mem(size_t *,size_t *,size_t *); /* from memory.c */
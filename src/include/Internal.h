@@ -243,6 +243,7 @@ SEXP do_lapply(SEXP, SEXP, SEXP, SEXP);  // Special
 CXXR::quick_builtin do_lazyLoadDBfetch;
 CXXR::quick_builtin do_lazyLoadDBflush;
 CXXR::quick_builtin do_lazyLoadDBinsertValue;
+CXXR::quick_builtin do_lazyLoadDBprefetch;
 CXXR::quick_builtin do_length;
 CXXR::quick_builtin do_lengthgets;
 SEXP do_lengths(SEXP, SEXP, SEXP, SEXP);
@@ -327,10 +328,12 @@ CXXR::quick_builtin do_readDCF;
 CXXR::quick_builtin do_readEnviron;
 CXXR::quick_builtin do_readlink;
 CXXR::quick_builtin do_readLines;
+CXXR::quick_builtin do_readdelim;
 CXXR::quick_builtin do_readln;
 SEXP do_recall(SEXP, SEXP, SEXP, SEXP);  // Special
 SEXP do_recordGraphics(SEXP, SEXP, SEXP, SEXP);
 SEXP do_refcnt(SEXP, SEXP, SEXP, SEXP);
+CXXR::quick_builtin do_regexcacheinfo;
 CXXR::quick_builtin do_regexec;
 CXXR::quick_builtin do_regexpr;
 CXXR::quick_builtin do_regFinaliz;
@@ -359,6 +362,7 @@ CXXR::quick_builtin do_seq_along;
 CXXR::quick_builtin do_seq_len;
 CXXR::quick_builtin do_serialize;
 CXXR::quick_builtin do_serializeToConn;
+CXXR::quick_builtin do_serializeToMappedFile;
 SEXP do_set(SEXP, SEXP, SEXP, SEXP);  // Special
 CXXR::quick_builtin do_setS4Object;
 CXXR::quick_builtin do_setFileTime;
@@ -410,6 +414,7 @@ CXXR::quick_builtin do_systime;
 CXXR::quick_builtin do_tabulate;
 CXXR::quick_builtin do_tempdir;
 CXXR::quick_builtin do_tempfile;
+CXXR::quick_builtin do_threadlapply;
 SEXP do_tilde(SEXP, SEXP, SEXP, SEXP);  // Special
 CXXR::quick_builtin do_tolower;
 SEXP do_topenv(SEXP, SEXP, SEXP, SEXP);
@@ -423,6 +428,7 @@ CXXR::quick_builtin do_unclass;
 CXXR::quick_builtin do_unlink;
 CXXR::quick_builtin do_unlist;
 CXXR::quick_builtin do_unserializeFromConn;
+CXXR::quick_builtin do_unserializeFromMappedFile;
 CXXR::quick_builtin do_unsetenv;
 SEXP do_usemethod(SEXP, SEXP, SEXP, SEXP);  // Special
 CXXR::quick_builtin do_utf8ToInt;
@@ -74,6 +74,10 @@ struct Rconn {
     void *ex_ptr;
     void *connprivate;
     int status; /* for pipes etc */
+    /* read-ahead buffer, if any: see set_buffer() in connections.cpp */
+    unsigned char *buff;
+    size_t buff_pos, buff_stored_len;
+    void *buffprivate;
 };
 
 #ifdef  __cplusplus
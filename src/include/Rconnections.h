@@ -68,6 +68,8 @@ typedef struct clpconn {
 #define con_pushback	Rf_con_pushback
 
 int Rconn_fgetc(Rconnection con);
+int Rconn_peek(Rconnection con, const char **data);
+void Rconn_consume(Rconnection con, size_t n);
 int Rconn_ungetc(int c, Rconnection con);
 int Rconn_getline(Rconnection con, char *buf, int bufsize);
 int Rconn_printf(Rconnection con, const char *format, ...);
@@ -90,6 +92,38 @@ int Rsockselect(int nsock, int *insockfd, int *ready, int *write, double timeout
 #define set_iconv Rf_set_iconv
 void set_iconv(Rconnection con);
 
+/* Buffered text output to a connection: output is assembled in
+   'data' and handed to the connection a block at a time, rather than
+   by a call to Rconn_printf for each item. */
+#define RCONN_OUTBUF_SIZE 16384
+typedef struct Rconn_outbuf {
+    Rconnection con;
+    size_t len;
+    char data[RCONN_OUTBUF_SIZE];
+} Rconn_outbuf;
+
+void Rconn_outbuf_init(Rconn_outbuf *ob, Rconnection con);
+void Rconn_outbuf_flush(Rconn_outbuf *ob);
+void Rconn_outbuf_write(Rconn_outbuf *ob, const char *s, size_t n);
+void Rconn_outbuf_int(Rconn_outbuf *ob, int x);
+Rboolean Rconn_outbuf_real(Rconn_outbuf *ob, double x, char dec);
+
+static R_INLINE void Rconn_outbuf_puts(Rconn_outbuf *ob, const char *s)
+{
+    Rconn_outbuf_write(ob, s, strlen(s));
+}
+
+/* Rconn_fgetc(con), taking the byte straight from the read-ahead
+   buffer when nothing needs to be done to it. */
+static R_INLINE int Rconn_fgetc_buffered(Rconnection con)
+{
+    if (con->buff_pos < con->buff_stored_len && con->nPushBack <= 0
+	&& con->save == -1000 && con->save2 == -1000 && !con->inconv
+	&& con->buff[con->buff_pos] != '\r')
+	return con->buff[con->buff_pos++];
+    return Rconn_fgetc(con);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -240,7 +240,7 @@ static void parent_sig_handler(int sig) {
 }
 #endif
 
-SEXP mc_fork(SEXP sEstranged)
+SEXP mc_fork(SEXP sEstranged, SEXP sFreeze)
 {
     int pipefd[2]; /* write end, read end */
     int sipfd[2];
@@ -248,6 +248,7 @@ SEXP mc_fork(SEXP sEstranged)
     SEXP res = allocVector(INTSXP, 3);
     int *res_i = INTEGER(res);
     int estranged = (asInteger(sEstranged) > 0);
+    int freeze = (asLogical(sFreeze) == TRUE);
 
     if (!estranged) {
 	if (pipe(pipefd)) error(_("unable to create a pipe"));
@@ -276,6 +277,8 @@ SEXP mc_fork(SEXP sEstranged)
     res_i[0] = (int) pid;
     if (pid == 0) { /* child */
 	R_isForkedChild = 1;
+	/* leave the objects shared with the master untouched */
+	if (freeze) R_FreezeHeap();
 	/* don't track any children of the child by default */
 	signal(SIGCHLD, SIG_DFL);
 	if (estranged)
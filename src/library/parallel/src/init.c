@@ -31,7 +31,7 @@ static const R_CallMethodDef callMethods[] = {
     {"mc_close_stdout", (DL_FUNC) &mc_close_stdout, 1},
     {"mc_exit", (DL_FUNC) &mc_exit, 1},
     {"mc_fds", (DL_FUNC) &mc_fds, 1},
-    {"mc_fork", (DL_FUNC) &mc_fork, 1},
+    {"mc_fork", (DL_FUNC) &mc_fork, 2},
     {"mc_is_child", (DL_FUNC) &mc_is_child, 0},
     {"mc_kill", (DL_FUNC) &mc_kill, 2},
     {"mc_master_fd", (DL_FUNC) &mc_master_fd, 0},
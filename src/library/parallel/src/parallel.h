@@ -39,7 +39,7 @@ SEXP mc_close_stdout(SEXP);
 SEXP mc_create_list(SEXP);
 SEXP mc_exit(SEXP);
 SEXP mc_fds(SEXP);
-SEXP mc_fork(SEXP);
+SEXP mc_fork(SEXP, SEXP);
 SEXP mc_is_child(void);
 SEXP mc_kill(SEXP, SEXP);
 SEXP mc_master_fd(void);
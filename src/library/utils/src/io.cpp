@@ -206,12 +206,12 @@ strtoc(const char *nptr, char **endptr, Rboolean NA, LocalData *d, int i_exact)
 static R_INLINE int scanchar_raw(LocalData *d)
 {
     int c = (d->ttyflag) ? ConsoleGetcharWithPushBack(d->con) :
-	Rconn_fgetc(d->con);
+	Rconn_fgetc_buffered(d->con);
     if(c == 0) {
 	if(d->skipNul) {
 	    do {
 		c = (d->ttyflag) ? ConsoleGetcharWithPushBack(d->con) :
-		    Rconn_fgetc(d->con);
+		    Rconn_fgetc_buffered(d->con);
 	    } while(c == 0);
 	}
     }
@@ -1012,6 +1012,48 @@ static const char
     return EncodeElement0(x, indx, quote ? '"' : 0, dec);
 }
 
+/* Writes what EncodeElement2 would return to ob, formatting logical,
+   integer and whole-number values and quoting strings directly. */
+static void
+WriteElement2(Rconn_outbuf *ob, SEXP x, int indx, Rboolean quote,
+	      Rboolean qmethod, R_StringBuffer *buff, const char *dec)
+{
+    if (indx < 0 || indx >= length(x))
+	error(_("index out of range"));
+    switch(TYPEOF(x)) {
+    case LGLSXP:
+	Rconn_outbuf_puts(ob, LOGICAL(x)[indx] ? "TRUE" : "FALSE");
+	return;
+    case INTSXP:
+	Rconn_outbuf_int(ob, INTEGER(x)[indx]);
+	return;
+    case REALSXP:
+	if(Rconn_outbuf_real(ob, REAL(x)[indx], dec[0])) return;
+	break;
+    case STRSXP:
+    {
+	const void *vmax = vmaxget();
+	const char *p = translateChar(STRING_ELT(x, indx)), *q;
+	if(!quote) Rconn_outbuf_puts(ob, p);
+	else {
+	    Rconn_outbuf_write(ob, "\"", 1);
+	    while((q = strchr(p, '"'))) {
+		Rconn_outbuf_write(ob, p, q - p);
+		Rconn_outbuf_write(ob, qmethod ? "\\\"" : "\"\"", 2);
+		p = q + 1;
+	    }
+	    Rconn_outbuf_puts(ob, p);
+	    Rconn_outbuf_write(ob, "\"", 1);
+	}
+	vmaxset(vmax);
+	return;
+    }
+    default:
+	break;
+    }
+    Rconn_outbuf_puts(ob, EncodeElement2(x, indx, quote, qmethod, buff, dec));
+}
+
 typedef struct wt_info {
     Rboolean wasopen;
     Rconnection con;
@@ -1033,9 +1075,10 @@ SEXP writetable(SEXP call, SEXP op, SEXP args, SEXP env)
     SEXP x, sep, rnames, eol, na, dec, quote, xj;
     Rboolean wasopen, quote_rn = FALSE, *quote_col;
     Rconnection con;
-    const char *csep, *ceol, *cna, *sdec, *tmp = NULL /* -Wall */;
+    const char *csep, *ceol, *cna, *sdec;
     SEXP *levels;
     R_StringBuffer strBuf = {NULL, 0, MAXELTSIZE};
+    Rconn_outbuf ob;
     wt_info wi;
 
     args = CDR(args);
@@ -1090,6 +1133,8 @@ SEXP writetable(SEXP call, SEXP op, SEXP args, SEXP env)
     wi.con = con;
     wi.wasopen = wasopen;
     wi.buf = &strBuf;
+    Rconn_outbuf_init(&ob, con);
+    size_t nsep = strlen(csep);
     try {
 	if(isVectorList(x)) { /* A data frame */
 
@@ -1106,38 +1151,38 @@ SEXP writetable(SEXP call, SEXP op, SEXP args, SEXP env)
 
 	    for(int i = 0; i < nr; i++) {
 		if(i % 1000 == 999) R_CheckUserInterrupt();
-		if(!isNull(rnames))
-		    Rconn_printf(con, "%s%s",
-				 EncodeElement2(rnames, i, quote_rn, Rboolean(qmethod),
-						&strBuf, sdec), csep);
+		if(!isNull(rnames)) {
+		    WriteElement2(&ob, rnames, i, quote_rn, Rboolean(qmethod),
+				  &strBuf, sdec);
+		    Rconn_outbuf_write(&ob, csep, nsep);
+		}
 		for(int j = 0; j < nc; j++) {
 		    xj = VECTOR_ELT(x, j);
-		    if(j > 0) Rconn_printf(con, "%s", csep);
-		    if(isna(xj, i)) tmp = cna;
+		    if(j > 0) Rconn_outbuf_write(&ob, csep, nsep);
+		    if(isna(xj, i)) Rconn_outbuf_puts(&ob, cna);
 		    else {
 			if(!isNull(levels[j])) {
 			    /* We do not assume factors have integer levels,
 			       although they should. */
 			    if(TYPEOF(xj) == INTSXP)
-				tmp = EncodeElement2(levels[j], INTEGER(xj)[i] - 1,
-						     quote_col[j], Rboolean(qmethod),
-						     &strBuf, sdec);
+				WriteElement2(&ob, levels[j], INTEGER(xj)[i] - 1,
+					      quote_col[j], Rboolean(qmethod),
+					      &strBuf, sdec);
 			    else if(TYPEOF(xj) == REALSXP)
-				tmp = EncodeElement2(levels[j], 
-						     (int) (REAL(xj)[i] - 1),
-						     quote_col[j], Rboolean(qmethod),
-						     &strBuf, sdec);
+				WriteElement2(&ob, levels[j],
+					      (int) (REAL(xj)[i] - 1),
+					      quote_col[j], Rboolean(qmethod),
+					      &strBuf, sdec);
 			    else
 				error(_("column %s claims to be a factor but does not have numeric codes"),
 				      j+1);
 			} else {
-			    tmp = EncodeElement2(xj, i, quote_col[j], Rboolean(qmethod),
-						 &strBuf, sdec);
+			    WriteElement2(&ob, xj, i, quote_col[j],
+					  Rboolean(qmethod), &strBuf, sdec);
 			}
 		    }
-		    Rconn_printf(con, "%s", tmp);
 		}
-		Rconn_printf(con, "%s", ceol);
+		Rconn_outbuf_puts(&ob, ceol);
 	    }
 
 	} else { /* A matrix */
@@ -1150,24 +1195,23 @@ SEXP writetable(SEXP call, SEXP op, SEXP args, SEXP env)
 	    
 	    for(int i = 0; i < nr; i++) {
 		if(i % 1000 == 999) R_CheckUserInterrupt();
-		if(!isNull(rnames))
-		    Rconn_printf(con, "%s%s",
-				 EncodeElement2(rnames, i, quote_rn,
-						Rboolean(qmethod),
-						&strBuf, sdec), csep);
+		if(!isNull(rnames)) {
+		    WriteElement2(&ob, rnames, i, quote_rn, Rboolean(qmethod),
+				  &strBuf, sdec);
+		    Rconn_outbuf_write(&ob, csep, nsep);
+		}
 		for(int j = 0; j < nc; j++) {
-		    if(j > 0) Rconn_printf(con, "%s", csep);
-		    if(isna(x, i + j*nr)) tmp = cna;
+		    if(j > 0) Rconn_outbuf_write(&ob, csep, nsep);
+		    if(isna(x, i + j*nr)) Rconn_outbuf_puts(&ob, cna);
 		    else {
-			tmp = EncodeElement2(x, i + j*nr, quote_col[j],
-					     Rboolean(qmethod),
-					     &strBuf, sdec);
+			WriteElement2(&ob, x, i + j*nr, quote_col[j],
+				      Rboolean(qmethod), &strBuf, sdec);
 		    }
-		    Rconn_printf(con, "%s", tmp);
 		}
-		Rconn_printf(con, "%s", ceol);
+		Rconn_outbuf_puts(&ob, ceol);
 	    }
 	}
+	Rconn_outbuf_flush(&ob);
     } catch (...) {
 	wt_cleanup(&wi);
 	throw;
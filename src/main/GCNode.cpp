@@ -48,6 +48,7 @@
 extern "C" {
 #  include "private/gc_priv.h"
 }
+#include <unordered_set>
 
 using namespace std;
 using namespace CXXR;
@@ -55,6 +56,7 @@ using namespace CXXR;
 vector<const GCNode*>* GCNode::s_moribund = 0;
 unsigned int GCNode::s_num_nodes = 0;
 bool GCNode::s_on_stack_bits_correct = false;
+bool GCNode::s_heap_frozen = false;
 const unsigned char GCNode::s_decinc_refcount[]
 = {0,    2, 2, 6, 6, 2, 2, 0xe, 0xe, 2, 2, 6, 6, 2, 2, 0x1e,
    0x1e, 2, 2, 6, 6, 2, 2, 0xe, 0xe, 2, 2, 6, 6, 2, 2, 0x3e,
@@ -96,6 +98,14 @@ static bool test_allocated_bit(void* allocation) {
     return GC_is_marked(allocation);
 }
 
+// Block flag recording that the objects in a heap block were frozen by
+// GCNode::freezeHeap().  It is not one of the flags used by the BDW
+// collector, and setup_header() clears it when a block is reused.
+static const unsigned char FROZEN_BLK = 0x80;
+
+// Frozen nodes visited during the current mark phase.
+static std::unordered_set<const GCNode*>* s_frozen_visited = nullptr;
+
 HOT_FUNCTION void* GCNode::operator new(size_t bytes)
 {
     GCManager::maybeGC();
@@ -211,6 +221,35 @@ void GCNode::gclite()
     s_on_stack_bits_correct = false;
 }
 
+void GCNode::freezeHeap()
+{
+#ifndef HAVE_ADDRESS_SANITIZER
+    if (s_heap_frozen)
+	return;
+    // Nodes awaiting gclite() now stay in existence for good.
+    s_moribund->clear();
+    GC_apply_to_all_blocks([](struct hblk* block, GC_word) {
+	    HDR(block)->hb_flags |= FROZEN_BLK;
+	}, 0);
+    // Discard the free lists, which thread through free space in
+    // frozen blocks, so that new objects are allocated in new blocks.
+    for (unsigned int kind = 0; kind < GC_n_kinds; ++kind) {
+	void** freelist = GC_obj_kinds[kind].ok_freelist;
+	if (freelist)
+	    std::fill(freelist, freelist + MAXOBJGRANULES + 1, nullptr);
+    }
+    s_heap_frozen = true;
+#endif
+}
+
+bool GCNode::isFrozen() const
+{
+    hdr* hhdr = HDR(get_allocation_from_object_pointer(
+			const_cast<GCNode*>(this)));
+    return hhdr && !IS_FORWARDING_ADDR_OR_NIL(hhdr)
+	&& (hhdr->hb_flags & FROZEN_BLK);
+}
+
 void GCNode::initialize()
 {
     s_moribund = new vector<const GCNode*>();
@@ -249,6 +288,8 @@ void GCNode::mark()
     // alternation.  This avoids the need for the sweep phase to
     // iterate through the surviving nodes simply to remove marks.
     s_mark ^= s_mark_mask;
+    if (s_heap_frozen)
+	s_frozen_visited = new std::unordered_set<const GCNode*>();
     GCNode::Marker marker;
     GCRootBase::visitRoots(&marker);
     GCStackRootBase::visitRoots(&marker);
@@ -257,6 +298,8 @@ void GCNode::mark()
     WeakRef::markThru();
     if (R_Srcref)
 	marker(R_Srcref);
+    delete s_frozen_visited;
+    s_frozen_visited = nullptr;
 }
 
 static GCNode* getNodePointerFromAllocation(void* allocation)
@@ -324,6 +367,13 @@ void GCNode::applyToAllAllocatedNodes(std::function<void(GCNode*)> f)
 
 void GCNode::Marker::operator()(const GCNode* node)
 {
+    if (!node->isWritable()) {
+	// Follow frozen nodes to the nodes they refer to without
+	// writing to them.
+	if (s_frozen_visited->insert(node).second)
+	    node->visitReferents(this);
+	return;
+    }
     if (node->isMarked()) {
 	return;
     }
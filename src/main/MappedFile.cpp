@@ -0,0 +1,115 @@
+/*
+ *  R : A Computer Language for Statistical Data Analysis
+ *  Copyright (C) 2014 and onwards the CXXR Project Authors.
+ *
+ *  CXXR is not part of the R project, and bugs and other issues should
+ *  not be reported via r-bugs or other R project channels; instead refer
+ *  to the CXXR website.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2.1 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, a copy is available at
+ *  http://www.r-project.org/Licenses/
+ */
+
+/** @file MappedFile.cpp
+ *
+ * Implementation of class MappedFile.
+ */
+
+#include "CXXR/MappedFile.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <map>
+
+#include "config.h"
+#include "localization.h"
+#include "R_ext/Error.h"
+
+#ifndef Win32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace CXXR;
+
+namespace {
+    // Mappings currently in existence, keyed by their start address,
+    // for release().
+    map<const char*, MappedFile*>* mappings()
+    {
+	static map<const char*, MappedFile*>* s_mappings
+	    = new map<const char*, MappedFile*>();
+	return s_mappings;
+    }
+}
+
+MappedFile* MappedFile::open(const char* path)
+{
+#ifdef Win32
+    Rf_error(_("memory-mapped files are not supported on this platform"));
+    return nullptr;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+	Rf_error(_("cannot open file '%s': %s"), path, strerror(errno));
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0) {
+	::close(fd);
+	Rf_error(_("cannot map empty or unreadable file '%s'"), path);
+    }
+    size_t size = size_t(sb.st_size);
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		      fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+	Rf_error(_("cannot map file '%s': %s"), path, strerror(errno));
+    MappedFile* ans = new MappedFile(static_cast<char*>(data), size);
+    (*mappings())[ans->m_data] = ans;
+    return ans;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    mappings()->erase(m_data);
+#ifndef Win32
+    munmap(m_data, m_size);
+#endif
+}
+
+void MappedFile::decRef()
+{
+    if (--m_refcount == 0)
+	delete this;
+}
+
+void MappedFile::release(const void* p)
+{
+    const char* cp = static_cast<const char*>(p);
+    map<const char*, MappedFile*>* maps = mappings();
+    auto it = maps->upper_bound(cp);
+    MappedFile* file = nullptr;
+    if (it != maps->begin()) {
+	file = (--it)->second;
+	if (cp >= file->m_data + file->m_size)
+	    file = nullptr;
+    }
+    assert(file);  // p must lie in some mapping.
+    if (file)
+	file->decRef();
+}
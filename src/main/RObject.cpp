@@ -72,7 +72,9 @@ RObject::RObject(const RObject& pattern)
     : m_type(pattern.m_type), m_named(0),
       m_memory_traced(pattern.m_memory_traced), m_missing(pattern.m_missing),
       m_argused(pattern.m_argused), m_active_binding(pattern.m_active_binding),
-      m_binding_locked(pattern.m_binding_locked)
+      m_binding_locked(pattern.m_binding_locked),
+      m_has_names(pattern.m_has_names), m_has_dim(pattern.m_has_dim),
+      m_has_dimnames(pattern.m_has_dimnames)
 {
     m_attrib = clone(pattern.m_attrib.get());
     maybeTraceMemory(&pattern);
@@ -89,6 +91,7 @@ void RObject::clearAttributes()
 	m_attrib = nullptr;
 	// Beware promotion to int by ~:
 	m_type &= static_cast<signed char>(~s_class_mask);
+	m_has_names = m_has_dim = m_has_dimnames = false;
     }
 }
 
@@ -110,12 +113,44 @@ RObject* RObject::evaluate(Environment* env)
 
 RObject* RObject::getAttribute(const Symbol* name) const
 {
+    if (!mayHaveAttribute(name))
+	return nullptr;
     for (PairList* node = m_attrib; node; node = node->tail())
 	if (node->tag() == name)
 	    return node->car();
     return nullptr;
 }
 
+bool RObject::mayHaveAttribute(const Symbol* name) const
+{
+    if (!m_attrib)
+	return false;
+    if (name == NamesSymbol)
+	return m_has_names;
+    if (name == DimSymbol)
+	return m_has_dim;
+    if (name == DimNamesSymbol)
+	return m_has_dimnames;
+    if (name == ClassSymbol)
+	return hasClass();
+    return true;
+}
+
+void RObject::noteAttribute(const Symbol* name, bool present)
+{
+    if (name == ClassSymbol) {
+	if (present)
+	    m_type |= static_cast<signed char>(s_class_mask);
+	else m_type &= static_cast<signed char>(~s_class_mask);
+    }
+    else if (name == NamesSymbol)
+	m_has_names = present;
+    else if (name == DimSymbol)
+	m_has_dim = present;
+    else if (name == DimNamesSymbol)
+	m_has_dimnames = present;
+}
+
 unsigned int RObject::packGPBits() const
 {
     unsigned int ans = 0;
@@ -130,12 +165,8 @@ void RObject::setAttribute(const Symbol* name, RObject* value)
 {
     if (!name)
 	Rf_error(_("attributes must be named"));
-    // Update 'has class' bit if necessary:
-    if (name == R_ClassSymbol) {
-	if (value == nullptr)
-	    m_type &= static_cast<signed char>(~s_class_mask);
-	else m_type |= static_cast<signed char>(s_class_mask);
-    }
+    // Update 'has class' etc. bits if necessary:
+    noteAttribute(name, value != nullptr);
     // Find attribute:
     PairList* prev = nullptr;
     PairList* node = m_attrib;
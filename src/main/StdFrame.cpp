@@ -102,6 +102,12 @@ void StdFrame::lockBindings()
     }
 }
 
+void StdFrame::reserve(size_t n)
+{
+    // This takes account of maximum_load_factor:
+    m_map.reserve(n);
+}
+
 size_t StdFrame::size() const
 {
     return m_map.size();
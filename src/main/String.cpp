@@ -30,9 +30,12 @@
 #include "CXXR/String.h"
 
 #include <algorithm>
+#include <vector>
 #include <boost/lambda/lambda.hpp>
 
 #include "CXXR/errors.h"
+#include "Defn.h"
+#include "rlocale.h"
 
 using namespace CXXR;
 
@@ -50,6 +53,24 @@ namespace CXXR {
     }
 }
 std::hash<std::string> String::Hasher::s_string_hasher;
+unsigned int String::s_locale_epoch = 0;
+
+// Strings of at least this many bytes index the offsets of every
+// OFFSET_STRIDE'th character:
+#define OFFSET_INDEX_MIN 256
+#define OFFSET_STRIDE 32
+
+struct String::Metadata {
+    unsigned int epoch;   // s_locale_epoch when computed
+    bool scanned;         // are the UTF-8 fields set?
+    bool valid;
+    bool nonprinting;
+    int nchars;
+    int width;
+    bool hashed;
+    std::uint64_t hash;
+    std::vector<int> offsets;
+};
 
 SEXP R_NaString = nullptr;
 SEXP R_BlankString = nullptr;
@@ -155,6 +176,11 @@ bool CXXR::isASCII(const std::string& str)
 }
 
 String* String::obtain(const std::string& str, cetype_t encoding)
+{
+    return obtain(str, encoding, false);
+}
+
+String* String::obtain(const std::string& str, cetype_t encoding, bool ascii)
 {
     // This will be checked again when we actually construct the
     // String, but we precheck now so that we don't create an
@@ -168,7 +194,8 @@ String* String::obtain(const std::string& str, cetype_t encoding)
     default:
         Rf_error("unknown encoding: %d", encoding);
     }
-    bool ascii = CXXR::isASCII(str);
+    if (!ascii)
+	ascii = CXXR::isASCII(str);
     if (ascii)
 	encoding = CE_NATIVE;
     std::pair<map::iterator, bool> pr
@@ -187,6 +214,136 @@ String* String::obtain(const std::string& str, cetype_t encoding)
     return (*it).second;
 }
 
+String::Metadata& String::metadata() const
+{
+    if (!m_metadata || m_metadata->epoch != s_locale_epoch) {
+	m_metadata.reset(new Metadata());
+	m_metadata->epoch = s_locale_epoch;
+    }
+    return *m_metadata;
+}
+
+namespace {
+    // The character of (valid) UTF-8 starting at s, of used bytes:
+    wchar_t decodeUTF8(const unsigned char* s, int used)
+    {
+	switch (used) {
+	case 1:
+	    return s[0];
+	case 2:
+	    return ((s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+	case 3:
+	    return ((s[0] & 0x0F) << 12) | ((s[1] & 0x3F) << 6)
+		| (s[2] & 0x3F);
+	default:
+	    return ((s[0] & 0x07) << 18) | ((s[1] & 0x3F) << 12)
+		| ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+	}
+    }
+
+    // 64-bit FNV-1a:
+    std::uint64_t fnv1a(const char* s, std::size_t len)
+    {
+	std::uint64_t h = 14695981039346656037ULL;
+	for (std::size_t i = 0; i < len; ++i) {
+	    h ^= static_cast<unsigned char>(s[i]);
+	    h *= 1099511628211ULL;
+	}
+	return h;
+    }
+}
+
+const String::Metadata& String::utf8Metadata() const
+{
+    Metadata& md = metadata();
+    if (md.scanned)
+	return md;
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(m_data);
+    std::size_t len = size();
+    bool index = (len >= OFFSET_INDEX_MIN);
+    md.valid = ::utf8Valid(m_data);
+    md.nonprinting = false;
+    md.nchars = md.width = 0;
+    for (std::size_t i = 0; i < len; ++md.nchars) {
+	if (index && md.nchars % OFFSET_STRIDE == 0)
+	    md.offsets.push_back(int(i));
+	int used = utf8clen(m_data[i]);
+	int w = 1;
+	if (md.valid) {
+	    w = Ri18n_wcwidth(decodeUTF8(s + i, used));
+	    if (w == -1)
+		md.nonprinting = true;
+	}
+	md.width += w;
+	i += used;
+    }
+    md.scanned = true;
+    return md;
+}
+
+bool String::utf8Valid() const
+{
+    return m_ascii || utf8Metadata().valid;
+}
+
+int String::utf8Chars() const
+{
+    return m_ascii ? int(size()) : utf8Metadata().nchars;
+}
+
+int String::utf8Width() const
+{
+    return utf8Metadata().width;
+}
+
+bool String::utf8HasNonprinting() const
+{
+    return utf8Metadata().nonprinting;
+}
+
+std::size_t String::utf8Offset(int n) const
+{
+    if (m_ascii)
+	return std::min(std::size_t(n), std::size_t(size()));
+    const Metadata& md = utf8Metadata();
+    if (n >= md.nchars)
+	return size();
+    std::size_t i = 0;
+    int k = 0;
+    if (!md.offsets.empty()) {
+	k = n - n % OFFSET_STRIDE;
+	i = md.offsets[n / OFFSET_STRIDE];
+    }
+    for (; k < n; ++k)
+	i += utf8clen(m_data[i]);
+    return i;
+}
+
+std::uint64_t String::hash() const
+{
+    if (m_ascii)
+	return fnv1a(m_data, size());
+    Metadata& md = metadata();
+    if (!md.hashed) {
+	if (m_encoding == CE_UTF8)
+	    md.hash = fnv1a(m_data, size());
+	else {
+	    const void* vmax = vmaxget();
+	    const char* text
+		= Rf_translateCharUTF8(const_cast<String*>(this));
+	    md.hash = fnv1a(text, strlen(text));
+	    vmaxset(vmax);
+	}
+	md.hashed = true;
+    }
+    return md.hash;
+}
+
+void String::localeChanged()
+{
+    ++s_locale_epoch;
+}
+
 unsigned int String::packGPBits() const
 {
     unsigned int ans = VectorBase::packGPBits();
@@ -223,6 +223,33 @@ void Subscripting::Indices::initialize(const LogicalVector* raw_indices,
     if (rawsize == 0)
 	return;
     m_min_lhssize = std::max(range_size, rawsize);
+    if (rawsize == m_min_lhssize) {
+	// The usual case of a mask as long as the vector: count and
+	// then compact without recycling, and without branching on
+	// the mask values.  The second loop stops at the last selected
+	// element, so every write is within the answer.
+	const Logical* mask = raw_indices->begin();
+	std::size_t anssize = 0;
+	for (std::size_t iin = 0; iin < rawsize; ++iin) {
+	    int lgl = int(mask[iin]);
+	    anssize += ((lgl == TRUE) | (lgl == NA_LOGICAL));
+	}
+	resize(anssize);
+	m_max_index = 0;
+	if (anssize == 0)
+	    return;
+	std::size_t* out = &(*this)[0];
+	std::size_t iout = 0;
+	for (std::size_t iin = 0; iout < anssize; ++iin) {
+	    int lgl = int(mask[iin]);
+	    bool is_true = (lgl == TRUE);
+	    bool is_na = (lgl == NA_LOGICAL);
+	    out[iout] = is_na ? 0 : iin + 1;
+	    iout += (is_true | is_na);
+	    m_max_index = is_true ? iin + 1 : m_max_index;
+	}
+	return;
+    }
     // Determine size of answer:
     std::size_t anssize = 0;
     for (std::size_t i = 0; i < m_min_lhssize; ++i)
@@ -246,6 +273,21 @@ void Subscripting::Indices::initialize(const LogicalVector* raw_indices,
     }
 }
 
+bool Subscripting::Indices::isContiguous() const
+{
+    std::size_t n = size();
+    if (n == 0)
+	return false;
+    const std::size_t* p = &(*this)[0];
+    std::size_t first = p[0];
+    if (first == 0)
+	return false;
+    for (std::size_t i = 1; i < n; ++i)
+	if (p[i] != first + i)
+	    return false;
+    return true;
+}
+
 void Subscripting::Indices::initialize(const StringVector* raw_indices,
 				       std::size_t range_size,
 				       const StringVector* range_names)
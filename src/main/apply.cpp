@@ -27,8 +27,125 @@
 #include <config.h>
 #endif
 
+#include <cfloat>
+#include <vector>
 #include <Defn.h>
 #include <Internal.h>
+#include "arithmetic.h"
+
+#include "CXXR/ArgList.hpp"
+#include "CXXR/StackChecker.hpp"
+
+using namespace CXXR;
+
+/* The value of x[[i + 1]] for a vector x that is not an object, or
+   NULL if x is not of a type handled here.  Used by lapply(), vapply()
+   and mapply() to pass elements to FUN without evaluating a call to
+   `[[`. */
+SEXP attribute_hidden R_vectorElement(SEXP x, R_xlen_t i)
+{
+    SEXP ans;
+    switch (TYPEOF(x)) {
+    case LGLSXP:
+	return ScalarLogical(LOGICAL(x)[i]);
+    case INTSXP:
+	return ScalarInteger(INTEGER(x)[i]);
+    case REALSXP:
+	return ScalarReal(REAL(x)[i]);
+    case CPLXSXP:
+	return ScalarComplex(COMPLEX(x)[i]);
+    case STRSXP:
+	return ScalarString(STRING_ELT(x, i));
+    case RAWSXP:
+	return ScalarRaw(RAW(x)[i]);
+    case VECSXP:
+	ans = VECTOR_ELT(x, i);
+	break;
+    case EXPRSXP:
+	ans = XVECTOR_ELT(x, i);
+	break;
+    default:
+	return nullptr;
+    }
+    /* As for `[[`: the element is now reachable from two places. */
+    if (NAMED(ans) < 2)
+	SET_NAMED(ans, 2);
+    return ans;
+}
+
+/* Invoke CLOSURE on PROMARGS, an already promise-wrapped argument
+   list, as if by evaluating CALL in RHO.  This skips the function
+   lookup and argument wrapping done by eval(), which the apply
+   functions do once rather than once per element. */
+SEXP attribute_hidden R_invokeClosure(const Closure* closure,
+				      Expression* call, PairList* promargs,
+				      Environment* rho)
+{
+    ArgList arglist(promargs, ArgList::PROMISED);
+    IncrementStackDepthScope scope;
+    closure->maybeTrace(call);
+    return closure->invoke(rho, &arglist, call);
+}
+
+/* If FUN, evaluated in RHO, is a closure and XX is a plain vector
+   whose elements R_vectorElement() can extract, return the closure,
+   otherwise NULL.  Objects keep going through `[[` so that methods
+   for it are dispatched. */
+static const Closure* directClosure(SEXP FUN, SEXP XX, SEXP rho)
+{
+    if (OBJECT(XX))
+	return nullptr;
+    switch (TYPEOF(XX)) {
+    case LGLSXP: case INTSXP: case REALSXP: case CPLXSXP:
+    case STRSXP: case RAWSXP: case VECSXP: case EXPRSXP:
+	break;
+    default:
+	return nullptr;
+    }
+    SEXP f = eval(FUN, rho);
+    return (TYPEOF(f) == CLOSXP) ? SEXP_downcast<const Closure*>(f) : nullptr;
+}
+
+/* Calls FUN(X[[i]], ...) in RHO for the closure found by
+   directClosure(), if any.  The promises for '...' are made once; each
+   element is passed as a promise that has already been forced, whose
+   expression is still X[[i]] so that substitute() and sys.call() in
+   FUN see what they would have seen. */
+namespace {
+    class ElementApplier {
+    public:
+	ElementApplier(const Closure* closure, SEXP fcall, SEXP rho)
+	    : m_closure(closure),
+	      m_call(SEXP_downcast<Expression*>(fcall)),
+	      m_rho(SEXP_downcast<Environment*>(rho)),
+	      m_dots(SEXP_downcast<PairList*>(CONS(R_DotsSymbol, R_NilValue)),
+		     ArgList::RAW)
+	{
+	    if (m_closure)
+		m_dots.wrapInPromises(m_rho);
+	}
+
+	bool active() const
+	{
+	    return m_closure != nullptr;
+	}
+
+	SEXP operator()(SEXP XX, R_xlen_t i)
+	{
+	    Expression* eltexpr = SEXP_downcast<Expression*>(CADR(m_call));
+	    GCStackRoot<> value(R_vectorElement(XX, i));
+	    Promise* elt = Promise::createEvaluatedPromise(eltexpr, value);
+	    PairList* promargs = SEXP_downcast<PairList*>(
+		CONS(elt, const_cast<PairList*>(m_dots.list())));
+	    return R_invokeClosure(m_closure, m_call, promargs, m_rho);
+	}
+    private:
+	const Closure* m_closure;
+	Expression* m_call;
+	Environment* m_rho;
+	ArgList m_dots;
+    };
+}
 
 /* .Internal(lapply(X, FUN)) */
 
@@ -75,10 +192,12 @@ SEXP attribute_hidden do_lapply(SEXP call, SEXP op, SEXP args, SEXP rho)
     SEXP R_fcall = PROTECT(LCONS(FUN,
 				 CONS(tmp, CONS(R_DotsSymbol, R_NilValue))));
 
+    ElementApplier direct(directClosure(FUN, XX, rho), R_fcall, rho);
+
     for(R_xlen_t i = 0; i < n; i++) {
 	if (realIndx) REAL(ind)[0] = (double)(i + 1);
 	else INTEGER(ind)[0] = (int)(i + 1);
-	tmp = eval(R_fcall, rho);
+	tmp = direct.active() ? direct(XX, i) : eval(R_fcall, rho);
 	if (MAYBE_REFERENCED(tmp)) tmp = lazy_duplicate(tmp);
 	SET_VECTOR_ELT(ans, i, tmp);
     }
@@ -161,13 +280,15 @@ SEXP attribute_hidden do_vapply(SEXP call, SEXP op, SEXP args, SEXP rho)
 	PROTECT(R_fcall = LCONS(FUN,
 				CONS(tmp, CONS(R_DotsSymbol, R_NilValue))));
 
+	ElementApplier direct(directClosure(FUN, XX, rho), R_fcall, rho);
+
 	int common_len_offset = 0;
 	for(i = 0; i < n; i++) {
 	    SEXP val; SEXPTYPE valType;
 	    PROTECT_INDEX indx;
 	    if (realIndx) REAL(ind)[0] = (double)(i + 1);
 	    else INTEGER(ind)[0] = (int)(i + 1);
-	    val = eval(R_fcall, rho);
+	    val = direct.active() ? direct(XX, i) : eval(R_fcall, rho);
 	    if (MAYBE_REFERENCED(val))
 		val = lazy_duplicate(val); // Need to duplicate? Copying again anyway
 	    PROTECT_WITH_INDEX(val, &indx);
@@ -418,3 +539,372 @@ SEXP attribute_hidden do_islistfactor(/*const*/ CXXR::Expression* call, const CX
 do_ans:
     return ScalarLogical(lans);
 }
+
+/* .Internal(threadLapply(X, FUN, nthreads)) */
+
+/* lapply(X, FUN) computed on up to 'nthreads' threads, for FUN a
+   function of one argument whose value can be computed from a plain
+   double vector without calling back into the interpreter: its body
+   (or FUN itself) may only combine the argument and numeric constants
+   with the arithmetic operators, sqrt, exp, log, abs, sum, prod, mean,
+   min, max and length, all of which must be the base versions.  Such
+   a FUN is compiled to a small expression tree, evaluated with fused
+   loops over each element of X by the worker threads, so nothing is
+   allocated and no R state is touched while they run.
+
+   Returns NULL, for the R code to use lapply() instead, if FUN cannot
+   be compiled, if an element of X is not a double vector without a
+   class (and, for results that are vectors, without attributes), or
+   if the computation for some element would have raised a warning. */
+
+namespace {
+    enum ThreadOp {
+	TH_CONST, TH_ARG, TH_NEG, TH_PLUS, TH_MINUS, TH_TIMES, TH_DIV,
+	TH_POW, TH_SQRT, TH_EXP, TH_LOG, TH_ABS, TH_SUM, TH_PROD,
+	TH_MEAN, TH_MIN, TH_MAX, TH_LENGTH
+    };
+
+    struct ThreadNode {
+	ThreadOp op;
+	bool scalar;   // value of length one, else of the argument's length
+	bool integer;  // only length(x) and -length(x)
+	int a, b;      // operands: earlier nodes
+	double value;  // TH_CONST
+    };
+
+    struct ThreadFun {
+	const char* name;
+	ThreadOp op;
+	int nargs;     // 1 or 2; TH_MINUS also accepts 1
+    };
+
+    const ThreadFun threadFuns[] = {
+	{"+", TH_PLUS, 2}, {"-", TH_MINUS, 2}, {"*", TH_TIMES, 2},
+	{"/", TH_DIV, 2}, {"^", TH_POW, 2}, {"sqrt", TH_SQRT, 1},
+	{"exp", TH_EXP, 1}, {"log", TH_LOG, 1}, {"abs", TH_ABS, 1},
+	{"sum", TH_SUM, 1}, {"prod", TH_PROD, 1}, {"mean", TH_MEAN, 1},
+	{"min", TH_MIN, 1}, {"max", TH_MAX, 1}, {"length", TH_LENGTH, 1}
+    };
+
+    typedef std::vector<ThreadNode> ThreadProgram;
+
+    int addThreadNode(ThreadProgram& prog, ThreadOp op, int a = -1,
+		      int b = -1, double value = 0)
+    {
+	ThreadNode node = {op, true, false, a, b, value};
+	switch (op) {
+	case TH_CONST:
+	    break;
+	case TH_ARG:
+	    node.scalar = false;
+	    break;
+	case TH_SUM: case TH_PROD: case TH_MEAN: case TH_MIN: case TH_MAX:
+	    if (prog[a].integer) return -1;
+	    break;
+	case TH_LENGTH:
+	    node.integer = true;
+	    break;
+	case TH_NEG: case TH_ABS:
+	    node.scalar = prog[a].scalar;
+	    node.integer = prog[a].integer;
+	    break;
+	case TH_PLUS: case TH_MINUS: case TH_TIMES:
+	    /* integer arithmetic could overflow, with a warning */
+	    if (prog[a].integer && prog[b].integer) return -1;
+	    /* fall through */
+	case TH_DIV: case TH_POW:
+	    node.scalar = prog[a].scalar && prog[b].scalar;
+	    break;
+	default:  /* Math functions */
+	    node.scalar = prog[a].scalar;
+	}
+	prog.push_back(node);
+	return int(prog.size()) - 1;
+    }
+
+    /* Is 'fun' the base function called 'name'? */
+    bool isBaseFunction(SEXP fun, const char* name)
+    {
+	return fun == findVarInFrame(R_BaseEnv, install(name));
+    }
+
+    /* Compiles expression e, in which symbol arg stands for the
+       argument and functions are looked up from env.  Returns the
+       index of the resulting node, or -1 if e is not supported. */
+    int compileThread(ThreadProgram& prog, SEXP e, SEXP arg, SEXP env)
+    {
+	if (TYPEOF(e) == REALSXP && XLENGTH(e) == 1
+	    && ATTRIB(e) == R_NilValue)
+	    return addThreadNode(prog, TH_CONST, -1, -1, REAL(e)[0]);
+	if (e == arg)
+	    return addThreadNode(prog, TH_ARG);
+	if (TYPEOF(e) != LANGSXP || TYPEOF(CAR(e)) != SYMSXP)
+	    return -1;
+	int nargs = 0;
+	for (SEXP a = CDR(e); a != R_NilValue; a = CDR(a)) {
+	    if (TAG(a) != R_NilValue || CAR(a) == R_DotsSymbol)
+		return -1;
+	    nargs++;
+	}
+	SEXP head = CAR(e);
+	const char* name = CHAR(PRINTNAME(head));
+	if (streql(name, "(") && nargs == 1)
+	    return (isBaseFunction(findFun(head, env), name)
+		    ? compileThread(prog, CADR(e), arg, env) : -1);
+	for (const ThreadFun& f : threadFuns) {
+	    if (!streql(name, f.name)) continue;
+	    bool unary_minus = (f.op == TH_MINUS && nargs == 1);
+	    if (nargs != f.nargs && !unary_minus) return -1;
+	    if (!isBaseFunction(findFun(head, env), name)) return -1;
+	    /* mean() dispatches on the implicit class */
+	    if (f.op == TH_MEAN
+		&& (findVar(install("mean.numeric"), env) != R_UnboundValue
+		    || findVar(install("mean.double"), env) != R_UnboundValue))
+		return -1;
+	    int a = compileThread(prog, CADR(e), arg, env);
+	    if (a < 0) return -1;
+	    if (unary_minus) return addThreadNode(prog, TH_NEG, a);
+	    if (nargs == 1) return addThreadNode(prog, f.op, a);
+	    int b = compileThread(prog, CADDR(e), arg, env);
+	    if (b < 0) return -1;
+	    return addThreadNode(prog, f.op, a, b);
+	}
+	return -1;
+    }
+
+    /* Compiles FUN, returning false if it is not supported. */
+    bool compileThreadFun(ThreadProgram& prog, SEXP FUN)
+    {
+	if (TYPEOF(FUN) == CLOSXP) {
+	    SEXP formals = FORMALS(FUN);
+	    if (formals != R_NilValue && CDR(formals) == R_NilValue
+		&& TAG(formals) != R_DotsSymbol
+		&& CAR(formals) == R_MissingArg) {
+		SEXP body = BODY_EXPR(FUN);
+		/* allow { expr } */
+		if (TYPEOF(body) == LANGSXP && CAR(body) == R_BraceSymbol
+		    && CDR(body) != R_NilValue && CDDR(body) == R_NilValue
+		    && isBaseFunction(findFun(R_BraceSymbol, CLOENV(FUN)), "{"))
+		    body = CADR(body);
+		if (compileThread(prog, body, TAG(formals), CLOENV(FUN)) >= 0)
+		    return true;
+	    }
+	    prog.clear();
+	}
+	/* FUN may itself be one of the functions supported */
+	for (const ThreadFun& f : threadFuns) {
+	    if (f.nargs == 1 && isBaseFunction(FUN, f.name)) {
+		if (f.op == TH_MEAN
+		    && (findVar(install("mean.numeric"), R_GlobalEnv)
+			!= R_UnboundValue
+			|| findVar(install("mean.double"), R_GlobalEnv)
+			!= R_UnboundValue))
+		    return false;
+		int a = addThreadNode(prog, TH_ARG);
+		return addThreadNode(prog, f.op, a) >= 0;
+	    }
+	}
+	return false;
+    }
+
+    /* Evaluates a program for one element of X. */
+    class ThreadEval {
+    public:
+	ThreadEval(const ThreadProgram& prog)
+	    : m_prog(prog), m_scalars(prog.size()), m_warn(false)
+	{}
+
+	/* Computes the value of the last node, into out[0] if it is
+	   scalar, else into out[0 .. n-1].  Returns false if R would
+	   have warned. */
+	bool run(const double* x, R_xlen_t n, double* out)
+	{
+	    m_x = x;
+	    m_n = n;
+	    m_warn = false;
+	    /* Scalars in order, so that each is available to later ones. */
+	    for (size_t k = 0; k < m_prog.size(); k++)
+		if (m_prog[k].scalar)
+		    m_scalars[k] = scalar(m_prog[k]);
+	    const ThreadNode& top = m_prog.back();
+	    if (top.scalar)
+		out[0] = m_scalars.back();
+	    else
+		for (R_xlen_t i = 0; i < n; i++)
+		    out[i] = at(int(m_prog.size()) - 1, i);
+	    return !m_warn;
+	}
+
+    private:
+	const ThreadProgram& m_prog;
+	std::vector<double> m_scalars;
+	const double* m_x;
+	R_xlen_t m_n;
+	bool m_warn;
+
+	double math1(double x, double y)
+	{
+	    if (ISNA(x)) return NA_REAL;
+	    if (ISNAN(y) && !ISNAN(x)) m_warn = true;
+	    return y;
+	}
+
+	double apply(ThreadOp op, double a, double b)
+	{
+	    switch (op) {
+	    case TH_NEG: return -a;
+	    case TH_PLUS: return a + b;
+	    case TH_MINUS: return a - b;
+	    case TH_TIMES: return a * b;
+	    case TH_DIV: return a / b;
+	    case TH_POW: return R_POW(a, b);
+	    case TH_SQRT: return math1(a, sqrt(a));
+	    case TH_EXP: return math1(a, exp(a));
+	    case TH_LOG: return math1(a, R_log(a));
+	    case TH_ABS: return fabs(a);
+	    default: return NA_REAL;  /* not reached */
+	    }
+	}
+
+	/* Element i of a node which is not scalar. */
+	double at(int k, R_xlen_t i)
+	{
+	    const ThreadNode& node = m_prog[k];
+	    if (node.scalar) return m_scalars[k];
+	    if (node.op == TH_ARG) return m_x[i];
+	    return apply(node.op, at(node.a, i),
+			 node.b < 0 ? 0 : at(node.b, i));
+	}
+
+	double scalar(const ThreadNode& node)
+	{
+	    /* The summaries and length() reduce over their operand,
+	       which is a single value if it is itself scalar. */
+	    R_xlen_t n = (node.a >= 0 && m_prog[node.a].scalar) ? 1 : m_n;
+	    switch (node.op) {
+	    case TH_CONST:
+		return node.value;
+	    case TH_LENGTH:
+		/* a long vector's length is a double */
+		if (n > INT_MAX) m_warn = true;
+		return double(n);
+	    case TH_SUM: case TH_PROD: {
+		/* as rsum() and rprod() */
+		LDOUBLE s = (node.op == TH_SUM) ? 0.0 : 1.0;
+		for (R_xlen_t i = 0; i < n; i++) {
+		    if (node.op == TH_SUM) s += at(node.a, i);
+		    else s *= at(node.a, i);
+		}
+		if (s > DBL_MAX) return R_PosInf;
+		else if (s < -DBL_MAX) return R_NegInf;
+		return double(s);
+	    }
+	    case TH_MEAN: {
+		/* as do_summary() */
+		LDOUBLE s = 0.0, t = 0.0;
+		for (R_xlen_t i = 0; i < n; i++) s += at(node.a, i);
+		s /= n;
+		if (R_FINITE(double(s))) {
+		    for (R_xlen_t i = 0; i < n; i++) t += (at(node.a, i) - s);
+		    s += t/n;
+		}
+		return double(s);
+	    }
+	    case TH_MIN: case TH_MAX: {
+		/* as rmin() and rmax() */
+		double s = 0.0;
+		bool updated = false;
+		for (R_xlen_t i = 0; i < n; i++) {
+		    double xi = at(node.a, i);
+		    if (ISNAN(xi)) {
+			if (!ISNA(s)) s = xi;
+			updated = true;
+		    } else if (!updated
+			       || (node.op == TH_MIN ? xi < s : xi > s)) {
+			s = xi;
+			updated = true;
+		    }
+		}
+		if (!updated) m_warn = true;  /* no non-missing arguments */
+		return s;
+	    }
+	    default:
+		return apply(node.op, m_scalars[node.a],
+			     node.b < 0 ? 0 : m_scalars[node.b]);
+	    }
+	}
+    };
+}  // anonymous namespace
+
+SEXP attribute_hidden do_threadlapply(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* rho, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
+{
+    op->checkNumArgs(num_args, call);
+    SEXP X = args[0], FUN = args[1];
+    int nthreads = asInteger(args[2]);
+    if (TYPEOF(X) != VECSXP)
+	error(_("invalid '%s' argument"), "X");
+    if (!isFunction(FUN))
+	error(_("invalid '%s' argument"), "FUN");
+    if (nthreads == NA_INTEGER || nthreads < 1)
+	error(_("invalid '%s' argument"), "nthreads");
+
+    ThreadProgram prog;
+    if (!compileThreadFun(prog, FUN))
+	return R_NilValue;
+    const ThreadNode& top = prog.back();
+
+    R_xlen_t n = XLENGTH(X);
+    for (R_xlen_t i = 0; i < n; i++) {
+	SEXP xi = VECTOR_ELT(X, i);
+	if (TYPEOF(xi) != REALSXP || OBJECT(xi)
+	    || (!top.scalar && ATTRIB(xi) != R_NilValue))
+	    return R_NilValue;
+    }
+
+    /* Allocate the results here, as the threads cannot. */
+    SEXP ans = PROTECT(allocVector(VECSXP, n));
+    std::vector<double> ivalues(top.integer ? n : 0);
+    std::vector<double*> out(n);
+    for (R_xlen_t i = 0; i < n; i++) {
+	if (top.integer) {
+	    SET_VECTOR_ELT(ans, i, allocVector(INTSXP, 1));
+	    out[i] = &ivalues[i];
+	} else {
+	    R_xlen_t len = top.scalar ? 1 : XLENGTH(VECTOR_ELT(X, i));
+	    SET_VECTOR_ELT(ans, i, allocVector(REALSXP, len));
+	    out[i] = REAL(VECTOR_ELT(ans, i));
+	}
+    }
+    std::vector<const double*> in(n);
+    std::vector<R_xlen_t> len(n);
+    for (R_xlen_t i = 0; i < n; i++) {
+	in[i] = REAL(VECTOR_ELT(X, i));
+	len[i] = XLENGTH(VECTOR_ELT(X, i));
+    }
+
+    int ok = 1;
+#ifdef _OPENMP
+    if (n < 2) nthreads = 1;
+#pragma omp parallel num_threads(nthreads) reduction(&:ok)
+#endif
+    {
+	ThreadEval eval(prog);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+	for (R_xlen_t i = 0; i < n; i++)
+	    if (!eval.run(in[i], len[i], out[i]))
+		ok = 0;
+    }
+    if (!ok) {
+	UNPROTECT(1);
+	return R_NilValue;
+    }
+    if (top.integer)
+	for (R_xlen_t i = 0; i < n; i++)
+	    INTEGER(VECTOR_ELT(ans, i))[0] = int(ivalues[i]);
+    SEXP names = getAttrib(X, R_NamesSymbol);
+    if (!isNull(names)) setAttrib(ans, R_NamesSymbol, names);
+    UNPROTECT(1);
+    return ans;
+}
@@ -734,6 +734,46 @@ static SEXP math1(SEXP sa, double (*f)(double), SEXP lcall)
     return result;
 }
 
+/* Functions that have no side effects, in particular that never raise
+   an R warning or error, are applied by math1_pure() instead: the
+   function is inlined into a loop with no per-element branches other
+   than the NA test, and vectors of at least R_MATH_PARALLEL_MIN
+   elements are split across R_num_math_threads threads.  The nmath
+   functions (gammafn() and friends) can warn, so stay with math1(). */
+
+#define R_MATH_PARALLEL_MIN 100000
+
+template <typename F>
+static SEXP math1_pure(SEXP sa, F f, SEXP lcall)
+{
+    if (!isNumeric(sa))
+	errorcall(lcall, R_MSG_NONNUM_MATH);
+    /* coercion can lose the object bit */
+    GCStackRoot<RealVector>
+	rv(static_cast<RealVector*>(coerceVector(sa, REALSXP)));
+    R_xlen_t n = rv->size();
+    GCStackRoot<RealVector> result(RealVector::create(n));
+    const double* x = rv->begin();
+    double* y = result->begin();
+    int naflag = 0;
+#ifdef _OPENMP
+    int nthreads = R_num_math_threads > 0 ? R_num_math_threads : 1;
+    if (n < R_MATH_PARALLEL_MIN)
+	nthreads = 1;
+#pragma omp parallel for num_threads(nthreads) reduction(|:naflag)
+#endif
+    for (R_xlen_t i = 0; i < n; i++) {
+	double xi = x[i];
+	double yi = f(xi);
+	naflag |= (ISNAN(yi) && !ISNAN(xi));
+	y[i] = ISNA(xi) ? NA_REAL : yi;
+    }
+    if (naflag)
+	Rf_warning(R_MSG_NA);
+    result->copyAttributes(rv, true);
+    return result;
+}
+
 SEXP attribute_hidden do_math1(SEXP call, SEXP op, SEXP args, SEXP env)
 {
     SEXP s;
@@ -748,29 +788,31 @@ SEXP attribute_hidden do_math1(SEXP call, SEXP op, SEXP args, SEXP env)
 	return complex_math1(call, op, args, env);
 
 #define MATH1(x) math1(CAR(args), x, call);
+#define MATH1_PURE(x)						\
+    math1_pure(CAR(args), [](double v) { return x(v); }, call);
     switch (PRIMVAL(op)) {
-    case 1: return MATH1(floor);
-    case 2: return MATH1(ceil);
-    case 3: return MATH1(sqrt);
-    case 4: return MATH1(sign);
+    case 1: return MATH1_PURE(floor);
+    case 2: return MATH1_PURE(ceil);
+    case 3: return MATH1_PURE(sqrt);
+    case 4: return MATH1_PURE(sign);
 	/* case 5: return MATH1(trunc); separate from 2.6.0 */
 
-    case 10: return MATH1(exp);
-    case 11: return MATH1(expm1);
-    case 12: return MATH1(log1p);
-    case 20: return MATH1(cos);
-    case 21: return MATH1(sin);
-    case 22: return MATH1(tan);
-    case 23: return MATH1(acos);
-    case 24: return MATH1(asin);
-    case 25: return MATH1(atan);
-
-    case 30: return MATH1(cosh);
-    case 31: return MATH1(sinh);
-    case 32: return MATH1(tanh);
-    case 33: return MATH1(acosh);
-    case 34: return MATH1(asinh);
-    case 35: return MATH1(atanh);
+    case 10: return MATH1_PURE(exp);
+    case 11: return MATH1_PURE(expm1);
+    case 12: return MATH1_PURE(log1p);
+    case 20: return MATH1_PURE(cos);
+    case 21: return MATH1_PURE(sin);
+    case 22: return MATH1_PURE(tan);
+    case 23: return MATH1_PURE(acos);
+    case 24: return MATH1_PURE(asin);
+    case 25: return MATH1_PURE(atan);
+
+    case 30: return MATH1_PURE(cosh);
+    case 31: return MATH1_PURE(sinh);
+    case 32: return MATH1_PURE(tanh);
+    case 33: return MATH1_PURE(acosh);
+    case 34: return MATH1_PURE(asinh);
+    case 35: return MATH1_PURE(atanh);
 
     case 40: return MATH1(lgammafn);
     case 41: return MATH1(gammafn);
@@ -810,7 +852,7 @@ SEXP attribute_hidden do_trunc(/*const*/ CXXR::Expression* call, const CXXR::Bui
     SEXP arg = num_args > 0 ? args[0] : R_NilValue;
     if (isComplex(arg))
 	errorcall(call, _("unimplemented complex function"));
-    return math1(arg, trunc, call);
+    return math1_pure(arg, [](double v) { return trunc(v); }, call);
 }
 
 /*
@@ -923,6 +965,39 @@ static SEXP math2(SEXP sa, SEXP sb, double (*f)(double, double),
     return sy;
 } /* math2() */
 
+/* As math2(), for functions without side effects, see math1_pure(). */
+template <typename F>
+static SEXP math2_pure(SEXP sa, SEXP sb, F f, SEXP lcall)
+{
+    SEXP sy;
+    R_xlen_t n, na, nb;
+    double *a, *b, *y;
+    int naflag;
+
+    if (!isNumeric(sa) || !isNumeric(sb))
+	errorcall(lcall, R_MSG_NONNUM_MATH);
+
+    SETUP_Math2;
+
+#ifdef _OPENMP
+    int nthreads = R_num_math_threads > 0 ? R_num_math_threads : 1;
+    if (n < R_MATH_PARALLEL_MIN)
+	nthreads = 1;
+#pragma omp parallel for num_threads(nthreads) reduction(|:naflag)
+#endif
+    for (R_xlen_t i = 0; i < n; i++) {
+	double ai = a[na == n ? i : i % na];
+	double bi = b[nb == n ? i : i % nb];
+	if_NA_Math2_set(y[i], ai, bi)
+	else {
+	    y[i] = f(ai, bi);
+	    naflag |= ISNAN(y[i]);
+	}
+    }
+    FINISH_Math2;
+    return sy;
+}
+
 static SEXP math2_1(SEXP sa, SEXP sb, SEXP sI,
 		    double (*f)(double, double, int), SEXP lcall)
 {
@@ -1034,6 +1109,9 @@ static SEXP math2B(SEXP sa, SEXP sb, double (*f)(double, double, double *),
 } /* math2B() */
 
 #define Math2(A, FUN)	  math2(CAR(A), CADR(A), FUN, call);
+#define Math2_PURE(A, FUN)					\
+    math2_pure(CAR(A), CADR(A),					\
+	       [](double x, double y) { return FUN(x, y); }, call);
 #define Math2_1(A, FUN)	math2_1(CAR(A), CADR(A), CADDR(A), FUN, call);
 #define Math2_2(A, FUN) math2_2(CAR(A), CADR(A), CADDR(A), CADDDR(A), FUN, call)
 #define Math2B(A, FUN)	  math2B(CAR(A), CADR(A), FUN, call);
@@ -1049,9 +1127,9 @@ SEXP attribute_hidden do_math2(SEXP call, SEXP op, SEXP args, SEXP env)
 
     switch (PRIMVAL(op)) {
 
-    case  0: return Math2(args, atan2);
-    case 10001: return Math2(args, fround);// round(),  ../nmath/fround.c
-    case 10004: return Math2(args, fprec); // signif(), ../nmath/fprec.c
+    case  0: return Math2_PURE(args, atan2);
+    case 10001: return Math2_PURE(args, fround);// round(),  ../nmath/fround.c
+    case 10004: return Math2_PURE(args, fprec); // signif(), ../nmath/fprec.c
 
     case  2: return Math2(args, lbeta);
     case  3: return Math2(args, beta);
@@ -1166,7 +1244,7 @@ SEXP attribute_hidden do_log1arg(/*const*/ CXXR::Expression* call, const CXXR::B
 	    res = complex_math2(call2, const_cast<BuiltInFunction*>(op),
 				args2, env);
 	else
-	    res = math2(args[0], tmp, logbase, call);
+	    res = math2_pure(args[0], tmp, logbase, call);
     }
     UNPROTECT(2);
     return res;
@@ -1201,7 +1279,7 @@ SEXP attribute_hidden do_log_builtin(SEXP call, SEXP op, SEXP args, SEXP env)
 	    if (isComplex(x))
 		res = complex_math1(call, op, args, env);
 	    else
-		res = math1(x, R_log, call);
+		res = math1_pure(x, R_log, call);
 	    UNPROTECT(1);
 	    return res;
 	}
@@ -1217,7 +1295,7 @@ SEXP attribute_hidden do_log_builtin(SEXP call, SEXP op, SEXP args, SEXP env)
 	    if (isComplex(x) || isComplex(y))
 		res = complex_math2(call, op, args, env);
 	    else
-		res = math2(x, y, logbase, call);
+		res = math2_pure(x, y, logbase, call);
 	    UNPROTECT(1);
 	    return res;
 	}
@@ -1239,7 +1317,7 @@ SEXP attribute_hidden do_log_builtin(SEXP call, SEXP op, SEXP args, SEXP env)
 	    if (isComplex(CAR(args)))
 		res = complex_math1(call, op, args, env);
 	    else
-		res = math1(CAR(args), R_log, call);
+		res = math1_pure(CAR(args), R_log, call);
 	}
 	UNPROTECT(1);
 	return res;
@@ -1261,7 +1339,7 @@ SEXP attribute_hidden do_log_builtin(SEXP call, SEXP op, SEXP args, SEXP env)
 	    if (isComplex(CAR(args)) || isComplex(CADR(args)))
 		res = complex_math2(call, op, args, env);
 	    else
-		res = math2(CAR(args), CADR(args), logbase, call);
+		res = math2_pure(CAR(args), CADR(args), logbase, call);
 	}
 	UNPROTECT(2);
 	return res;
@@ -105,7 +105,7 @@ SEXP attribute_hidden getAttrib0(SEXP vec, SEXP name)
 
     if (!vec) return nullptr;
     if (name == R_NamesSymbol) {
-	if(isVector(vec) || isList(vec) || isLanguage(vec)) {
+	if (vec->hasDim() && (isVector(vec) || isList(vec) || isLanguage(vec))) {
 	    s = getAttrib(vec, R_DimSymbol);
 	    if(TYPEOF(s) == INTSXP && length(s) == 1) {
 		s = getAttrib(vec, R_DimNamesSymbol);
@@ -33,17 +33,16 @@
 
 #include <Defn.h>
 #include <Internal.h>
-#include <R_ext/PrtUtil.h> // for IndexWidth
 #define imax2(x, y) ((x < y) ? y : x)
 
-#include "RBufferUtils.h"
+#include <algorithm>
+#include <string>
+
 #include "CXXR/GCStackRoot.hpp"
 
 using namespace std;
 using namespace CXXR;
 
-static R_StringBuffer cbuff = {nullptr, 0, MAXELTSIZE};
-
 static SEXP cbind(SEXP, SEXP, SEXPTYPE, SEXP, int);
 static SEXP rbind(SEXP, SEXP, SEXPTYPE, SEXP, int);
 
@@ -198,6 +197,27 @@ namespace {
 	    SET_VECTOR_ELT(data->ans_ptr, data->ans_length, x);
 	data->ans_length++;
     }
+
+    /* Append the n elements of src to the answer, whose data start at
+       ans, converting each by conv. */
+    template <typename T, typename S, typename F>
+    inline void AppendAnswer(struct BindData* data, T* ans, const S* src,
+			     R_xlen_t n, F conv)
+    {
+	T* dest = ans + data->ans_length;
+	for (R_xlen_t i = 0; i < n; i++)
+	    dest[i] = conv(src[i]);
+	data->ans_length += n;
+    }
+
+    /* Inputs of the answer's own type are copied in bulk. */
+    template <typename T>
+    inline void AppendAnswer(struct BindData* data, T* ans, const T* src,
+			     R_xlen_t n)
+    {
+	std::copy(src, src + n, ans + data->ans_length);
+	data->ans_length += n;
+    }
 }
 
 static void
@@ -323,18 +343,17 @@ LogicalAnswer(SEXP x, struct BindData *data, SEXP call)
 	    LogicalAnswer(VECTOR_ELT(x, i), data, call);
 	break;
     case LGLSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    LOGICAL(data->ans_ptr)[data->ans_length++] = LOGICAL(x)[i];
+	AppendAnswer(data, LOGICAL(data->ans_ptr), LOGICAL(x), XLENGTH(x));
 	break;
     case INTSXP:
-	for (i = 0; i < XLENGTH(x); i++) {
-	    int v = INTEGER(x)[i];
-	    LOGICAL(data->ans_ptr)[data->ans_length++] = (v == NA_INTEGER) ? NA_LOGICAL : ( v != 0 );
-	}
+	AppendAnswer(data, LOGICAL(data->ans_ptr), INTEGER(x), XLENGTH(x),
+		     [](int v) {
+			 return (v == NA_INTEGER) ? NA_LOGICAL : ( v != 0 );
+		     });
 	break;
     case RAWSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    LOGICAL(data->ans_ptr)[data->ans_length++] = (int)RAW(x)[i] != 0;
+	AppendAnswer(data, LOGICAL(data->ans_ptr), RAW(x), XLENGTH(x),
+		     [](Rbyte v) { return (int)v != 0; });
 	break;
     default:
 	errorcall(call, _("type '%s' is unimplemented in '%s'"),
@@ -364,16 +383,16 @@ IntegerAnswer(SEXP x, struct BindData *data, SEXP call)
 	    IntegerAnswer(VECTOR_ELT(x, i), data, call);
 	break;
     case LGLSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    INTEGER(data->ans_ptr)[data->ans_length++] = LOGICAL(x)[i];
+	AppendAnswer(data, INTEGER(data->ans_ptr),
+		     static_cast<const int*>(LOGICAL(x)), XLENGTH(x));
 	break;
     case INTSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    INTEGER(data->ans_ptr)[data->ans_length++] = INTEGER(x)[i];
+	AppendAnswer(data, INTEGER(data->ans_ptr),
+		     static_cast<const int*>(INTEGER(x)), XLENGTH(x));
 	break;
     case RAWSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    INTEGER(data->ans_ptr)[data->ans_length++] = int(RAW(x)[i]);
+	AppendAnswer(data, INTEGER(data->ans_ptr), RAW(x), XLENGTH(x),
+		     [](Rbyte v) { return int(v); });
 	break;
     default:
 	errorcall(call, _("type '%s' is unimplemented in '%s'"),
@@ -385,7 +404,6 @@ static void
 RealAnswer(SEXP x, struct BindData *data, SEXP call)
 {
     R_xlen_t i;
-    int xi;
     switch(TYPEOF(x)) {
     case NILSXP:
 	break;
@@ -404,28 +422,24 @@ RealAnswer(SEXP x, struct BindData *data, SEXP call)
 	    RealAnswer(XVECTOR_ELT(x, i), data, call);
 	break;
     case REALSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    REAL(data->ans_ptr)[data->ans_length++] = REAL(x)[i];
+	AppendAnswer(data, REAL(data->ans_ptr),
+		     static_cast<const double*>(REAL(x)), XLENGTH(x));
 	break;
     case LGLSXP:
-	for (i = 0; i < XLENGTH(x); i++) {
-	    xi = LOGICAL(x)[i];
-	    if (xi == NA_LOGICAL)
-		REAL(data->ans_ptr)[data->ans_length++] = NA_REAL;
-	    else REAL(data->ans_ptr)[data->ans_length++] = xi;
-	}
+	AppendAnswer(data, REAL(data->ans_ptr), LOGICAL(x), XLENGTH(x),
+		     [](int v) {
+			 return (v == NA_LOGICAL) ? NA_REAL : double(v);
+		     });
 	break;
     case INTSXP:
-	for (i = 0; i < XLENGTH(x); i++) {
-	    xi = INTEGER(x)[i];
-	    if (xi == NA_INTEGER)
-		REAL(data->ans_ptr)[data->ans_length++] = NA_REAL;
-	    else REAL(data->ans_ptr)[data->ans_length++] = xi;
-	}
+	AppendAnswer(data, REAL(data->ans_ptr), INTEGER(x), XLENGTH(x),
+		     [](int v) {
+			 return (v == NA_INTEGER) ? NA_REAL : double(v);
+		     });
 	break;
     case RAWSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    REAL(data->ans_ptr)[data->ans_length++] = int(RAW(x)[i]);
+	AppendAnswer(data, REAL(data->ans_ptr), RAW(x), XLENGTH(x),
+		     [](Rbyte v) { return double(int(v)); });
 	break;
     default:
 	errorcall(call, _("type '%s' is unimplemented in '%s'"),
@@ -463,8 +477,8 @@ ComplexAnswer(SEXP x, struct BindData *data, SEXP call)
 	}
 	break;
     case CPLXSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    COMPLEX(data->ans_ptr)[data->ans_length++] = COMPLEX(x)[i];
+	AppendAnswer(data, COMPLEX(data->ans_ptr),
+		     static_cast<const Rcomplex*>(COMPLEX(x)), XLENGTH(x));
 	break;
     case LGLSXP:
 	for (i = 0; i < XLENGTH(x); i++) {
@@ -528,8 +542,8 @@ RawAnswer(SEXP x, struct BindData *data, SEXP call)
 	    RawAnswer(VECTOR_ELT(x, i), data, call);
 	break;
     case RAWSXP:
-	for (i = 0; i < XLENGTH(x); i++)
-	    RAW(data->ans_ptr)[data->ans_length++] = RAW(x)[i];
+	AppendAnswer(data, RAW(data->ans_ptr),
+		     static_cast<const Rbyte*>(RAW(x)), XLENGTH(x));
 	break;
     default:
 	errorcall(call, _("type '%s' is unimplemented in '%s'"),
@@ -537,21 +551,26 @@ RawAnswer(SEXP x, struct BindData *data, SEXP call)
     }
 }
 
+/* base.tag, built in UTF-8. */
+static SEXP DottedName(SEXP base, SEXP tag)
+{
+    const void *vmax = vmaxget();
+    std::string name(translateCharUTF8(base));
+    name += '.';
+    name += translateCharUTF8(tag);
+    vmaxset(vmax);
+    /* This isn't strictly correct as we do not know that all the
+       components of the name were correctly translated. */
+    return mkCharLenCE(name.data(), int(name.size()), CE_UTF8);
+}
+
 static SEXP NewBase(SEXP base, SEXP tag)
 {
     SEXP ans;
-    char *cbuf;
     base = EnsureString(base);
     tag = EnsureString(tag);
     if (*CHAR(base) && *CHAR(tag)) { /* test of length */
-	const void *vmax = vmaxget();
-	const char *sb = translateCharUTF8(base), *st = translateCharUTF8(tag);
-	cbuf = static_cast<char*>(R_AllocStringBuffer(strlen(st) + strlen(sb) + 1, &cbuff));
-	sprintf(cbuf, "%s.%s", sb, st);
-	/* This isn't strictly correct as we do not know that all the
-	   components of the name were correctly translated. */
-	ans = mkCharCE(cbuf, CE_UTF8);
-	vmaxset(vmax);
+	ans = DottedName(base, tag);
     }
     else if (*CHAR(tag)) {
 	ans = tag;
@@ -573,32 +592,22 @@ static SEXP NewName(SEXP base, SEXP tag, int seqno)
  */
 
     SEXP ans;
-    char *cbuf;
     const void *vmax = vmaxget();
 
     base = EnsureString(base);
     tag = EnsureString(tag);
     if (*CHAR(base) && *CHAR(tag)) {
-	const char *sb = translateCharUTF8(base), *st = translateCharUTF8(tag);
-	cbuf = static_cast<char*>(R_AllocStringBuffer(strlen(sb) + strlen(st) + 1, &cbuff));
-	sprintf(cbuf, "%s.%s", sb, st);
-	ans = mkCharCE(cbuf, CE_UTF8);
+	ans = DottedName(base, tag);
     }
     else if (*CHAR(base)) {
-	const char *sb = translateChar(base);
-	cbuf = static_cast<char*>(R_AllocStringBuffer(strlen(sb) + size_t( IndexWidth(seqno)),
-						      &cbuff));
-	sprintf(cbuf, "%s%d", sb, seqno);
-	ans = mkCharCE(cbuf, CE_UTF8);
+	std::string name(translateChar(base));
+	name += std::to_string(seqno);
+	ans = mkCharLenCE(name.data(), int(name.size()), CE_UTF8);
     }
     else if (*CHAR(tag)) {
-	if(tag == NA_STRING) ans = NA_STRING;
-	else {
-	    const char *st = translateCharUTF8(tag);
-	    cbuf = static_cast<char*>(R_AllocStringBuffer(strlen(st), &cbuff));
-	    sprintf(cbuf, "%s", st);
-	    ans = mkCharCE(cbuf, CE_UTF8);
-	}
+	/* Already in the form the translation would give: */
+	if(tag == NA_STRING || IS_ASCII(tag) || IS_UTF8(tag)) ans = tag;
+	else ans = mkCharCE(translateCharUTF8(tag), CE_UTF8);
     }
     else ans = R_BlankString;
     vmaxset(vmax);
@@ -629,15 +638,41 @@ struct NameData {
  int count;
  int seqno;
  int firstpos;
+ int firstseqno;
+ int depth;	/* number of enclosing tags */
 };
 
+/* Name the next element of the answer, given its own name namei.
+ * Beneath a tag, the first unnamed element is named only when the
+ * tag's scope closes: it then takes the tag itself as its name if it
+ * is the only element there, so building base<seqno> for it now
+ * would usually be wasted. */
+
+static void NewElementName(SEXP base, SEXP namei, struct BindData *data,
+			   struct NameData *nameData)
+{
+    ++(nameData->seqno);
+    if (namei == R_NilValue && nameData->count == 0) {
+	nameData->firstpos = data->ans_nnames;
+	nameData->firstseqno = nameData->seqno;
+	if (nameData->depth > 0) {
+	    nameData->count++;
+	    (data->ans_nnames)++;
+	    return;
+	}
+    }
+    nameData->count++;
+    SET_STRING_ELT(data->ans_names, (data->ans_nnames)++,
+		   NewName(base, namei, nameData->seqno));
+}
+
 
 static void NewExtractNames(SEXP v, SEXP base, SEXP tag, int recurse,
 			     struct BindData *data, struct NameData *nameData)
 {
     SEXP names, namei;
     R_xlen_t i, n;
-    int savecount=0, saveseqno, savefirstpos=0;
+    int savecount=0, saveseqno, savefirstpos=0, savefirstseqno=0;
 
     /* If we beneath a new tag, we reset the index */
     /* sequence and create the new basename string. */
@@ -645,11 +680,13 @@ static void NewExtractNames(SEXP v, SEXP base, SEXP tag, int recurse,
     if (tag != R_NilValue) {
 	PROTECT(base = NewBase(base, tag));
 	savefirstpos = nameData->firstpos;
+	savefirstseqno = nameData->firstseqno;
 	saveseqno = nameData->seqno;
 	savecount = nameData->count;
 	nameData->count = 0;
 	nameData->seqno = 0;
 	nameData->firstpos = -1;
+	nameData->depth++;
     }
     else saveseqno = 0;
 
@@ -665,13 +702,8 @@ static void NewExtractNames(SEXP v, SEXP base, SEXP tag, int recurse,
 	    if (recurse) {
 		NewExtractNames(CAR(v), base, namei, recurse, data, nameData);
 	    }
-	    else {
-		if (namei == R_NilValue && nameData->count == 0)
-		    nameData->firstpos = data->ans_nnames;
-		nameData->count++;
-		namei = NewName(base, namei, ++(nameData->seqno));
-		SET_STRING_ELT(data->ans_names, (data->ans_nnames)++, namei);
-	    }
+	    else
+		NewElementName(base, namei, data, nameData);
 	    v = CDR(v);
 	    UNPROTECT(1); /*namei*/
 	}
@@ -682,13 +714,8 @@ static void NewExtractNames(SEXP v, SEXP base, SEXP tag, int recurse,
 	    if (recurse) {
 		NewExtractNames(VECTOR_ELT(v, i), base, namei, recurse, data, nameData);
 	    }
-	    else {
-		if (namei == R_NilValue && nameData->count == 0)
-		    nameData->firstpos = data->ans_nnames;
-		nameData->count++;
-		namei = NewName(base, namei, ++(nameData->seqno));
-		SET_STRING_ELT(data->ans_names, (data->ans_nnames)++, namei);
-	    }
+	    else
+		NewElementName(base, namei, data, nameData);
 	}
 	break;
     case EXPRSXP:
@@ -697,13 +724,8 @@ static void NewExtractNames(SEXP v, SEXP base, SEXP tag, int recurse,
 	    if (recurse) {
 		NewExtractNames(XVECTOR_ELT(v, i), base, namei, recurse, data, nameData);
 	    }
-	    else {
-		if (namei == R_NilValue && nameData->count == 0)
-		    nameData->firstpos = data->ans_nnames;
-		nameData->count++;
-		namei = NewName(base, namei, ++(nameData->seqno));
-		SET_STRING_ELT(data->ans_names, (data->ans_nnames)++, namei);
-	    }
+	    else
+		NewElementName(base, namei, data, nameData);
 	}
 	break;
     case LGLSXP:
@@ -712,27 +734,21 @@ static void NewExtractNames(SEXP v, SEXP base, SEXP tag, int recurse,
     case CPLXSXP:
     case STRSXP:
     case RAWSXP:
-	for (i = 0; i < n; i++) {
-	    namei = ItemName(names, i);
-	    if (namei == R_NilValue && nameData->count == 0)
-		nameData->firstpos = data->ans_nnames;
-	    nameData->count++;
-	    namei = NewName(base, namei, ++(nameData->seqno));
-	    SET_STRING_ELT(data->ans_names, (data->ans_nnames)++, namei);
-	}
+	for (i = 0; i < n; i++)
+	    NewElementName(base, ItemName(names, i), data, nameData);
 	break;
     default:
-	if (nameData->count == 0)
-	    nameData->firstpos = data->ans_nnames;
-	nameData->count++;
-	namei = NewName(base, R_NilValue, ++(nameData->seqno));
-	SET_STRING_ELT(data->ans_names, (data->ans_nnames)++, namei);
+	NewElementName(base, R_NilValue, data, nameData);
     }
     if (tag != R_NilValue) {
-	if (nameData->firstpos >= 0 && nameData->count == 1)
-	    SET_STRING_ELT(data->ans_names, nameData->firstpos, base);
+	if (nameData->firstpos >= 0)
+	    SET_STRING_ELT(data->ans_names, nameData->firstpos,
+			   (nameData->count == 1) ? base
+			   : NewName(base, R_NilValue, nameData->firstseqno));
 	nameData->firstpos = savefirstpos;
+	nameData->firstseqno = savefirstseqno;
 	nameData->count = savecount;
+	nameData->depth--;
 	UNPROTECT(1);
     }
     UNPROTECT(1); /*names*/
@@ -897,6 +913,7 @@ SEXP attribute_hidden do_c_dflt(SEXP call, SEXP op, SEXP args, SEXP env)
 	    nameData.seqno = 0;
 	    nameData.firstpos = 0;
 	    nameData.count = 0;
+	    nameData.depth = 0;
 	    NewExtractNames(CAR(args), R_NilValue, TAG(args), recurse, &data, &nameData);
 	    args = CDR(args);
 	}
@@ -904,7 +921,6 @@ SEXP attribute_hidden do_c_dflt(SEXP call, SEXP op, SEXP args, SEXP env)
 	UNPROTECT(1);
     }
     UNPROTECT(2);
-    R_FreeStringBufferL(&cbuff);
     return ans;
 } /* do_c */
 
@@ -1024,6 +1040,7 @@ SEXP attribute_hidden do_unlist(/*const*/ CXXR::Expression* call, const CXXR::Bu
 		nameData.seqno = 0;
 		nameData.firstpos = 0;
 		nameData.count = 0;
+		nameData.depth = 0;
 		for (i = 0; i < n; i++) {
 		    NewExtractNames(VECTOR_ELT(args, i), R_NilValue,
 				    ItemName(names, i), recurse, &data, &nameData);
@@ -1034,6 +1051,7 @@ SEXP attribute_hidden do_unlist(/*const*/ CXXR::Expression* call, const CXXR::Bu
 		nameData.seqno = 0;
 		nameData.firstpos = 0;
 		nameData.count = 0;
+		nameData.depth = 0;
 		while (args != R_NilValue) {
 		    NewExtractNames(CAR(args), R_NilValue,
 				    TAG(args), recurse, &data, &nameData);
@@ -1046,13 +1064,13 @@ SEXP attribute_hidden do_unlist(/*const*/ CXXR::Expression* call, const CXXR::Bu
 	    nameData.seqno = 0;
 	    nameData.firstpos = 0;
 	    nameData.count = 0;
+	    nameData.depth = 0;
 	    NewExtractNames(args, R_NilValue, R_NilValue, recurse, &data, &nameData);
 	}
 	setAttrib(ans, R_NamesSymbol, data.ans_names);
 	UNPROTECT(1);
     }
     UNPROTECT(2);
-    R_FreeStringBufferL(&cbuff);
     return ans;
 } /* do_unlist */
 
@@ -1228,6 +1246,73 @@ static void SetColNames(SEXP dimnames, SEXP x)
 	SETCADR(dimnames, x);
 }
 
+/* The copying loops of cbind() and rbind().  Each argument is either
+ * a matrix or a vector recycled to fill the extent it occupies; the
+ * modulus that recycling needs is taken only when the argument really
+ * is shorter than that extent. */
+
+namespace {
+    template <typename T>
+    inline T SameValue(T v)
+    {
+	return v;
+    }
+
+    inline double IntToReal(int v)
+    {
+	return (v == NA_INTEGER) ? NA_REAL : v;
+    }
+
+    inline int RawToLogical(Rbyte v)
+    {
+	return v ? TRUE : FALSE;
+    }
+
+    inline int RawToInteger(Rbyte v)
+    {
+	return static_cast<unsigned char>(v);
+    }
+
+    /* cbind(): the idx elements from dest on are filled from the k
+       elements of src. */
+    template <typename T, typename S, typename F>
+    void FillColumns(T* dest, R_xlen_t idx, const S* src, R_xlen_t k,
+		     F conv)
+    {
+	if (k >= idx)
+	    std::transform(src, src + idx, dest, conv);
+	else
+	    for (R_xlen_t i = 0; i < idx; i++)
+		dest[i] = conv(src[i % k]);
+    }
+
+    template <typename T>
+    void FillColumns(T* dest, R_xlen_t idx, const T* src, R_xlen_t k)
+    {
+	if (k >= idx)
+	    std::copy(src, src + idx, dest);
+	else
+	    for (R_xlen_t i = 0; i < idx; i++)
+		dest[i] = src[i % k];
+    }
+
+    /* rbind(): rows n to n + idx - 1 of dest, which has nr rows and
+       cols columns, are filled from the k elements of src. */
+    template <typename T, typename S, typename F>
+    void FillRows(T* dest, R_xlen_t nr, R_xlen_t n, int cols,
+		  R_xlen_t idx, const S* src, R_xlen_t k, F conv)
+    {
+	if (k == idx * cols) {
+	    for (int j = 0; j < cols; j++)
+		std::transform(src + j * idx, src + (j + 1) * idx,
+			       dest + n + j * nr, conv);
+	} else
+	    for (R_xlen_t i = 0; i < idx; i++)
+		for (int j = 0; j < cols; j++)
+		    dest[i + n + (j * nr)] = conv(src[(i + j * idx) % k]);
+    }
+}
+
 /*
  * Apparently i % 0 could occur here (PR#2541).  But it should not,
  * as zero-length vectors are ignored and
@@ -1369,8 +1454,9 @@ static SEXP cbind(SEXP call, SEXP args, SEXPTYPE mode, SEXP rho,
 		u = coerceVector(u, CPLXSXP);
 		R_xlen_t k = XLENGTH(u);
 		R_xlen_t idx = (!isMatrix(u)) ? rows : k;
-		for (R_xlen_t i = 0; i < idx; i++)
-		    COMPLEX(result)[n++] = COMPLEX(u)[i % k];
+		FillColumns(COMPLEX(result) + n, idx,
+			    static_cast<const Rcomplex*>(COMPLEX(u)), k);
+		n += idx;
 	    }
 	}
     }
@@ -1381,8 +1467,9 @@ static SEXP cbind(SEXP call, SEXP args, SEXPTYPE mode, SEXP rho,
 		u = coerceVector(u, RAWSXP);
 		R_xlen_t k = XLENGTH(u);
 		R_xlen_t idx = (!isMatrix(u)) ? rows : k;
-		for (R_xlen_t i = 0; i < idx; i++)
-		    RAW(result)[n++] = RAW(u)[i % k];
+		FillColumns(RAW(result) + n, idx,
+			    static_cast<const Rbyte*>(RAW(u)), k);
+		n += idx;
 	    }
 	}
     }
@@ -1393,18 +1480,15 @@ static SEXP cbind(SEXP call, SEXP args, SEXPTYPE mode, SEXP rho,
 		R_xlen_t k = XLENGTH(u);
 		R_xlen_t idx = (!isMatrix(u)) ? rows : k;
 		if (TYPEOF(u) <= INTSXP) { /* INT or LGL */
-		    if (mode <= INTSXP) {
-			for (R_xlen_t i = 0; i < idx; i++)
-			    INTEGER(result)[n++] = INTEGER(u)[i % k];
-		    }
-		    else {
-			for (R_xlen_t i = 0; i < idx; i++)
-			    REAL(result)[n++] = (INTEGER(u)[i % k]) == NA_INTEGER ? NA_REAL : INTEGER(u)[i % k];
-		    }
+		    const int* src = INTEGER(u);
+		    if (mode <= INTSXP)
+			FillColumns(INTEGER(result) + n, idx, src, k);
+		    else
+			FillColumns(REAL(result) + n, idx, src, k, IntToReal);
 		}
 		else if (TYPEOF(u) == REALSXP) {
-		    for (R_xlen_t i = 0; i < idx; i++)
-			REAL(result)[n++] = REAL(u)[i % k];
+		    FillColumns(REAL(result) + n, idx,
+				static_cast<const double*>(REAL(u)), k);
 		}
 		else { /* RAWSXP */
 		    /* FIXME: I'm not sure what the author intended when the sequence was
@@ -1412,12 +1496,13 @@ static SEXP cbind(SEXP call, SEXP args, SEXPTYPE mode, SEXP rho,
 		       raw losslessly but not vice versa. So due to the way this was
 		       defined the raw -> logical conversion is bound to be lossy .. */
 		    if (mode == LGLSXP)
-			for (R_xlen_t i = 0; i < idx; i++)
-			    LOGICAL(result)[n++] = RAW(u)[i % k] ? TRUE : FALSE;
+			FillColumns(LOGICAL(result) + n, idx, RAW(u), k,
+				    RawToLogical);
 		    else
-			for (R_xlen_t i = 0; i < idx; i++)
-			    INTEGER(result)[n++] = static_cast<unsigned char>( RAW(u)[i % k]);
+			FillColumns(INTEGER(result) + n, idx, RAW(u), k,
+				    RawToInteger);
 		}
+		n += idx;
 	    }
 	}
     }
@@ -1602,10 +1687,8 @@ static SEXP rbind(SEXP call, SEXP args, SEXPTYPE mode, SEXP rho,
 		u = coerceVector(u, RAWSXP);
 		R_xlen_t k = XLENGTH(u);
 		R_xlen_t idx = (isMatrix(u)) ? nrows(u) : (k > 0);
-		for (R_xlen_t i = 0; i < idx; i++)
-		    for (int j = 0; j < cols; j++)
-			RAW(result)[i + n + (j * rows)]
-			    = RAW(u)[(i + j * idx) % k];
+		FillRows(RAW(result), rows, n, cols, idx, RAW(u), k,
+			 SameValue<Rbyte>);
 		n += idx;
 	    }
 	}
@@ -1617,10 +1700,8 @@ static SEXP rbind(SEXP call, SEXP args, SEXPTYPE mode, SEXP rho,
 		u = coerceVector(u, CPLXSXP);
 		R_xlen_t k = XLENGTH(u);
 		R_xlen_t idx = (isMatrix(u)) ? nrows(u) : (k > 0);
-		for (R_xlen_t i = 0; i < idx; i++)
-		    for (int j = 0; j < cols; j++)
-			COMPLEX(result)[i + n + (j * rows)]
-			    = COMPLEX(u)[(i + j * idx) % k];
+		FillRows(COMPLEX(result), rows, n, cols, idx, COMPLEX(u), k,
+			 SameValue<Rcomplex>);
 		n += idx;
 	    }
 	}
@@ -1632,40 +1713,26 @@ static SEXP rbind(SEXP call, SEXP args, SEXPTYPE mode, SEXP rho,
 		R_xlen_t k = XLENGTH(u);
 		R_xlen_t idx = (isMatrix(u)) ? nrows(u) : (k > 0);
 		if (TYPEOF(u) <= INTSXP) {
-		    if (mode <= INTSXP) {
-			for (R_xlen_t i = 0; i < idx; i++)
-			    for (int j = 0; j < cols; j++)
-				INTEGER(result)[i + n + (j * rows)]
-				    = INTEGER(u)[(i + j * idx) % k];
-			n += idx;
-		    }
-		    else {
-			for (R_xlen_t i = 0; i < idx; i++)
-			    for (int j = 0; j < cols; j++)
-				REAL(result)[i + n + (j * rows)]
-				    = (INTEGER(u)[(i + j * idx) % k]) == NA_INTEGER ? NA_REAL : INTEGER(u)[(i + j * idx) % k];
-			n += idx;
-		    }
+		    if (mode <= INTSXP)
+			FillRows(INTEGER(result), rows, n, cols, idx,
+				 INTEGER(u), k, SameValue<int>);
+		    else
+			FillRows(REAL(result), rows, n, cols, idx,
+				 INTEGER(u), k, IntToReal);
+		    n += idx;
 		}
 		else if (TYPEOF(u) == REALSXP) {
-		    for (R_xlen_t i = 0; i < idx; i++)
-			for (int j = 0; j < cols; j++)
-			    REAL(result)[i + n + (j * rows)]
-				= REAL(u)[(i + j * idx) % k];
+		    FillRows(REAL(result), rows, n, cols, idx,
+			     REAL(u), k, SameValue<double>);
 		    n += idx;
 		}
 		else { /* RAWSXP */
-		    if (mode == LGLSXP) {
-			for (R_xlen_t i = 0; i < idx; i++)
-			    for (int j = 0; j < cols; j++)
-				LOGICAL(result)[i + n + (j * rows)]
-				    = RAW(u)[(i + j * idx) % k] ? TRUE : FALSE;
-		    }
+		    if (mode == LGLSXP)
+			FillRows(LOGICAL(result), rows, n, cols, idx,
+				 RAW(u), k, RawToLogical);
 		    else
-			for (R_xlen_t i = 0; i < idx; i++)
-			    for (int j = 0; j < cols; j++)
-				INTEGER(result)[i + n + (j * rows)]
-				    = static_cast<unsigned char>( RAW(u)[(i + j * idx) % k]);
+			FillRows(INTEGER(result), rows, n, cols, idx,
+				 RAW(u), k, RawToInteger);
 		}
 	    }
 	}
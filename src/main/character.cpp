@@ -169,36 +169,40 @@ SEXP attribute_hidden do_nchar(/*const*/ CXXR::Expression* call, const CXXR::Bui
 	if (strncmp(type, "bytes", ntype) == 0) {
 	    INTEGER(s)[i] = LENGTH(sxi);
 	} else if (strncmp(type, "chars", ntype) == 0) {
+	    const String* str = SEXP_downcast<const String*>(sxi);
 	    if (IS_UTF8(sxi)) { /* assume this is valid */
-		const char *p = CHAR(sxi);
-		nc = 0;
-		for( ; *p; p += utf8clen(*p)) nc++;
-		INTEGER(s)[i] = nc;
+		INTEGER(s)[i] = str->utf8Chars();
 	    } else if (IS_BYTES(sxi)) {
 		if (!allowNA) /* could do chars 0 */
 		    error(_("number of characters is not computable for element %d in \"bytes\" encoding"), i+1);
 		INTEGER(s)[i] = NA_INTEGER;
+	    } else if (IS_ASCII(sxi)) {
+		INTEGER(s)[i] = LENGTH(sxi);
 	    } else if (mbcslocale) {
-		nc = int( mbstowcs(nullptr, translateChar(sxi), 0));
+		/* native text in a UTF-8 locale has its count cached */
+		if (utf8locale && !IS_LATIN1(sxi))
+		    nc = str->utf8Valid() ? str->utf8Chars() : -1;
+		else
+		    nc = int( mbstowcs(nullptr, translateChar(sxi), 0));
 		if (!allowNA && nc < 0)
 		    error(_("invalid multibyte string %d"), i+1);
 		INTEGER(s)[i] = nc >= 0 ? nc : NA_INTEGER;
 	    } else
 		INTEGER(s)[i] = int( strlen(translateChar(sxi)));
 	} else if (strncmp(type, "width", ntype) == 0) {
+	    const String* str = SEXP_downcast<const String*>(sxi);
 	    if (IS_UTF8(sxi)) { /* assume this is valid */
-		const char *p = CHAR(sxi);
-		wchar_t wc1;
-		nc = 0;
-		for( ; *p; p += utf8clen(*p)) {
-		    utf8toucs(&wc1, p);
-		    nc += Ri18n_wcwidth(wc1);
-		}
-		INTEGER(s)[i] = nc;
+		INTEGER(s)[i] = str->utf8Width();
 	    } else if (IS_BYTES(sxi)) {
 		if (!allowNA) /* could do width 0 */
 		    error(_("width is not computable for element %d in \"bytes\" encoding"), i+1);
 		INTEGER(s)[i] = NA_INTEGER;
+	    } else if (mbcslocale && utf8locale && !IS_ASCII(sxi)
+		       && !IS_LATIN1(sxi) && str->utf8Valid()) {
+		/* as below, from the cached width */
+		INTEGER(s)[i] = str->utf8HasNonprinting()
+		    ? -1 : str->utf8Width();
+		if (INTEGER(s)[i] < 1) INTEGER(s)[i] = str->utf8Chars();
 	    } else if (mbcslocale) {
 		xi = translateChar(sxi);
 		nc = int( mbstowcs(nullptr, xi, 0));
@@ -294,6 +298,18 @@ SEXP attribute_hidden do_substr(/*const*/ CXXR::Expression* call, const CXXR::Bu
 	    }
 	    ienc = getCharCE(el);
 	    ss = CHAR(el);
+	    const String* str = SEXP_downcast<const String*>(el);
+	    if (ienc == CE_UTF8
+		|| (ienc == CE_NATIVE && utf8locale && !IS_ASCII(el)
+		    && str->utf8Valid())) {
+		/* UTF-8: find the ends from the cached character offsets */
+		if (start < 1) start = 1;
+		size_t from = str->utf8Offset(start - 1),
+		    to = (start > stop) ? from : str->utf8Offset(stop);
+		SET_STRING_ELT(s, i, mkCharLenCE(ss + from, int(to - from),
+						 ienc));
+		continue;
+	    }
 	    slen = strlen(ss); /* FIXME -- should handle embedded nuls */
 	    buf = static_cast<char*>(R_AllocStringBuffer(slen+1, &cbuff));
 	    if (start < 1) start = 1;
@@ -88,11 +88,13 @@
 #include <Internal.h>
 #include <Fileio.h>
 #include <Rconnections.h>
+#include <Print.h>
 #include <R_ext/Complex.h>
 #include <R_ext/R-ftp-http.h>
 #include <R_ext/RS.h>		/* R_chk_calloc and Free */
 #include <R_ext/Riconv.h>
 #include "basedecl.h"
+#include <algorithm>
 #include <cstdarg>
 
 #include "CXXR/ProvenanceTracker.h"
@@ -117,6 +119,10 @@ static void con_destroy(int i);
 # include <unistd.h>
 #endif
 
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+
 #ifdef HAVE_FCNTL_H
 # include <fcntl.h>
 /* Solaris and AIX define open as open64 under some circumstances */
@@ -543,6 +549,148 @@ void init_con(Rconnection newconn, const char *description, int enc,
     newconn->id = current_id;
     newconn->ex_ptr = nullptr;
     newconn->status = NA_INTEGER;
+    newconn->buff = nullptr;
+    newconn->buff_pos = newconn->buff_stored_len = 0;
+    newconn->buffprivate = nullptr;
+}
+
+/* ------------------- read-ahead buffering --------------------- */
+
+/* A connection to a regular file opened only for reading gets a
+   read-ahead buffer.  set_buffer() interposes on the connection's
+   read, fgetc_internal, seek and close methods, so every reader
+   (including readBin, readChar and unserialize) sees the same stream
+   and small reads are served from memory.  Text readers can go
+   further and work on whole spans of the buffer: Rconn_peek() and
+   Rconn_consume() give access to it when nothing (pushback, CR
+   mapping or re-encoding) stands between it and Rconn_fgetc(), and
+   Rconn_fgetc_buffered() is an inline Rconn_fgetc() for the same
+   case. */
+
+#define RBUFFCON_LEN 65536
+
+typedef struct buffconn {
+    void (*close)(Rconnection);
+    int (*fgetc_internal)(Rconnection);
+    double (*seek)(Rconnection, double, int, int);
+    size_t (*read)(void *, size_t, size_t, Rconnection);
+} *Rbuffconn;
+
+static size_t buff_fill(Rconnection con)
+{
+    Rbuffconn b = static_cast<Rbuffconn>(con->buffprivate);
+    con->buff_pos = 0;
+    con->buff_stored_len = b->read(con->buff, 1, RBUFFCON_LEN, con);
+    return con->buff_stored_len;
+}
+
+static int buff_fgetc(Rconnection con)
+{
+    if (con->buff_pos == con->buff_stored_len && buff_fill(con) == 0)
+	return R_EOF;
+    return con->buff[con->buff_pos++];
+}
+
+static size_t buff_read(void *ptr, size_t size, size_t nitems,
+			Rconnection con)
+{
+    Rbuffconn b = static_cast<Rbuffconn>(con->buffprivate);
+    char *p = static_cast<char *>(ptr);
+    size_t n = size * nitems, done = 0;
+
+    while (done < n) {
+	size_t avail = con->buff_stored_len - con->buff_pos;
+	if (avail == 0) {
+	    /* large reads bypass the buffer */
+	    if (n - done >= RBUFFCON_LEN) {
+		done += b->read(p + done, 1, n - done, con);
+		break;
+	    }
+	    if (buff_fill(con) == 0) break;
+	    continue;
+	}
+	if (avail > n - done) avail = n - done;
+	memcpy(p + done, con->buff + con->buff_pos, avail);
+	con->buff_pos += avail;
+	done += avail;
+    }
+    return size ? done / size : 0;
+}
+
+static double buff_seek(Rconnection con, double where, int origin, int rw)
+{
+    Rbuffconn b = static_cast<Rbuffconn>(con->buffprivate);
+    double unread = double(con->buff_stored_len - con->buff_pos);
+
+    if (ISNA(where)) return b->seek(con, where, origin, rw) - unread;
+    if (origin == 2) where -= unread;
+    double pos = b->seek(con, where, origin, rw) - unread;
+    con->buff_pos = con->buff_stored_len = 0;
+    return pos;
+}
+
+static void buff_close(Rconnection con)
+{
+    Rbuffconn b = static_cast<Rbuffconn>(con->buffprivate);
+    con->close = b->close;
+    con->fgetc_internal = b->fgetc_internal;
+    con->seek = b->seek;
+    con->read = b->read;
+    free(b);
+    free(con->buff);
+    con->buff = nullptr;
+    con->buff_pos = con->buff_stored_len = 0;
+    con->buffprivate = nullptr;
+    con->close(con);
+}
+
+/* Called by the open methods of file-like connections. */
+static void set_buffer(Rconnection con)
+{
+    struct stat sb;
+
+    if (con->buff || !con->canread || con->canwrite || !con->blocking
+	|| con->fgetc != &dummy_fgetc || streql(con->description, "stdin")
+	|| stat(R_ExpandFileName(con->description), &sb) != 0
+	|| !S_ISREG(sb.st_mode))
+	return;
+    Rbuffconn b = static_cast<Rbuffconn>(malloc(sizeof(struct buffconn)));
+    unsigned char *buff = static_cast<unsigned char *>(malloc(RBUFFCON_LEN));
+    if (!b || !buff) { /* just read unbuffered */
+	free(b); free(buff);
+	return;
+    }
+    b->close = con->close;
+    b->fgetc_internal = con->fgetc_internal;
+    b->seek = con->seek;
+    b->read = con->read;
+    con->close = &buff_close;
+    con->fgetc_internal = &buff_fgetc;
+    con->seek = &buff_seek;
+    con->read = &buff_read;
+    con->buff = buff;
+    con->buff_pos = con->buff_stored_len = 0;
+    con->buffprivate = b;
+}
+
+/* If the next input can be taken directly from the read-ahead buffer,
+   set *data to point to it and return the number of bytes there,
+   refilling the buffer if it is empty (so 0 means EOF).  Otherwise
+   return -1, and the input must be read by Rconn_fgetc(). */
+int Rconn_peek(Rconnection con, const char **data)
+{
+    if (!con->buff || con->nPushBack > 0 || con->save != -1000
+	|| con->save2 != -1000 || con->inconv)
+	return -1;
+    if (con->buff_pos == con->buff_stored_len) buff_fill(con);
+    *data = reinterpret_cast<const char *>(con->buff + con->buff_pos);
+    return int(con->buff_stored_len - con->buff_pos);
+}
+
+/* Consume n bytes returned by Rconn_peek(). */
+void Rconn_consume(Rconnection con, size_t n)
+{
+    con->buff_pos += n;
 }
 
 /* ------------------- file connections --------------------- */
@@ -661,6 +809,7 @@ static Rboolean file_open(Rconnection con)
 	fcntl(fd, F_SETFL, flags);
     }
 #endif
+    set_buffer(con);
     return TRUE;
 }
 
@@ -1506,6 +1655,7 @@ static Rboolean gzfile_open(Rconnection con)
     con->text = strchr(con->mode, 'b') ? FALSE : TRUE;
     set_iconv(con);
     con->save = -1000;
+    set_buffer(con);
     return TRUE;
 }
 
@@ -1659,6 +1809,7 @@ static Rboolean bzfile_open(Rconnection con)
     con->text = strchr(con->mode, 'b') ? FALSE : TRUE;
     set_iconv(con);
     con->save = -1000;
+    set_buffer(con);
     return TRUE;
 }
 
@@ -1852,6 +2003,7 @@ static Rboolean xzfile_open(Rconnection con)
     con->text = strchr(con->mode, 'b') ? FALSE : TRUE;
     set_iconv(con);
     con->save = -1000;
+    set_buffer(con);
     return TRUE;
 }
 
@@ -2007,7 +2159,448 @@ newxzfile(const char *description, const char *mode, int type, int compress)
     return newconn;
 }
 
-/* op 0 is gzfile, 1 is bzfile, 2 is xv/lzma */
+/* ------------------- block-compressed gzip files --------------------- */
+
+/* A bgzfile is a sequence of independently deflated gzip members
+   ('blocks'), each holding at most BGZ_BLOCK_SIZE bytes of data.  It
+   is thus an ordinary multi-member gzip file, which gzip and gzfile()
+   can read.  The header of each member carries an extra field with
+   subfield ID "RB" giving the total size of the member and the number
+   of bytes of data in it (both 4-byte little-endian), so that a reader
+   can find every block without inflating anything.
+
+   Up to R_num_math_threads blocks at a time are compressed or
+   decompressed in parallel.  On opening for reading the block headers
+   are scanned to build an index, which seek() uses to go straight to
+   the block containing a position. */
+
+#define BGZ_BLOCK_SIZE (1 << 20)
+#define BGZ_HEADER_SIZE 24
+#define BGZ_TRAILER_SIZE 8
+
+typedef struct bgzblock {
+    OFF_T offset;	/* of the member in the file */
+    double start;	/* position of its data in the uncompressed stream */
+    unsigned int csize;	/* size of the member */
+    unsigned int usize;	/* bytes of data */
+} bgzblock;
+
+typedef struct bgzfileconn {
+    FILE *fp;
+    int compress;
+    int nthreads;
+    unsigned char *cbuf;   /* nthreads member buffers of cbufsize bytes */
+    size_t cbufsize;
+    size_t *clen;          /* member sizes, when writing */
+    unsigned char *ubuf;   /* up to nthreads * BGZ_BLOCK_SIZE bytes of data */
+    size_t ulen, upos;
+    double ustart;         /* position of ubuf[0] in the uncompressed stream */
+    bgzblock *index;       /* when reading */
+    size_t nblocks, next;  /* next: first block not yet in ubuf */
+} *Rbgzfileconn;
+
+static void bgz_put_le16(unsigned char *p, unsigned int x)
+{
+    p[0] = static_cast<unsigned char>(x & 0xff);
+    p[1] = static_cast<unsigned char>((x >> 8) & 0xff);
+}
+
+static void bgz_put_le32(unsigned char *p, unsigned int x)
+{
+    bgz_put_le16(p, x & 0xffff);
+    bgz_put_le16(p + 2, x >> 16);
+}
+
+static unsigned int bgz_get_le16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned int bgz_get_le32(const unsigned char *p)
+{
+    return bgz_get_le16(p) | (bgz_get_le16(p + 2) << 16);
+}
+
+/* Is h the header of a block?  If so, return its sizes. */
+static Rboolean bgz_parse_header(const unsigned char *h,
+				 unsigned int *csize, unsigned int *usize)
+{
+    if (h[0] != 0x1f || h[1] != 0x8b || h[2] != Z_DEFLATED || h[3] != 4
+	|| bgz_get_le16(h + 10) != 12 || h[12] != 'R' || h[13] != 'B'
+	|| bgz_get_le16(h + 14) != 8)
+	return FALSE;
+    *csize = bgz_get_le32(h + 16);
+    *usize = bgz_get_le32(h + 20);
+    return CXXRCONSTRUCT(Rboolean,
+			 *csize >= BGZ_HEADER_SIZE + BGZ_TRAILER_SIZE
+			 && *usize <= BGZ_BLOCK_SIZE);
+}
+
+/* Compress n bytes at in into a complete member at out.  Returns the
+   size of the member, or 0 on failure.  Safe to call on any thread. */
+static size_t bgz_deflate(const unsigned char *in, size_t n,
+			  unsigned char *out, size_t outsize, int level)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8,
+		     Z_DEFAULT_STRATEGY) != Z_OK)
+	return 0;
+    zs.next_in = const_cast<Bytef*>(in);
+    zs.avail_in = uInt(n);
+    zs.next_out = out + BGZ_HEADER_SIZE;
+    zs.avail_out = uInt(outsize - BGZ_HEADER_SIZE - BGZ_TRAILER_SIZE);
+    int res = deflate(&zs, Z_FINISH);
+    size_t clen = zs.total_out;
+    deflateEnd(&zs);
+    if (res != Z_STREAM_END)
+	return 0;
+
+    size_t total = BGZ_HEADER_SIZE + clen + BGZ_TRAILER_SIZE;
+    memset(out, 0, BGZ_HEADER_SIZE);
+    out[0] = 0x1f; out[1] = 0x8b; out[2] = Z_DEFLATED;
+    out[3] = 4;	  /* FEXTRA */
+    out[9] = 255; /* OS unknown */
+    bgz_put_le16(out + 10, 12);
+    out[12] = 'R'; out[13] = 'B';
+    bgz_put_le16(out + 14, 8);
+    bgz_put_le32(out + 16, static_cast<unsigned int>(total));
+    bgz_put_le32(out + 20, static_cast<unsigned int>(n));
+    unsigned char *trailer = out + BGZ_HEADER_SIZE + clen;
+    bgz_put_le32(trailer, static_cast<unsigned int>(crc32(0L, in, uInt(n))));
+    bgz_put_le32(trailer + 4, static_cast<unsigned int>(n));
+    return total;
+}
+
+/* Inflate the member in (of csize bytes) into its usize bytes of data
+   at out, checking the CRC.  Returns nonzero on failure.  Safe to call
+   on any thread. */
+static int bgz_inflate(const unsigned char *in, size_t csize,
+		       unsigned char *out, size_t usize)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+	return 1;
+    zs.next_in = const_cast<Bytef*>(in + BGZ_HEADER_SIZE);
+    zs.avail_in = uInt(csize - BGZ_HEADER_SIZE - BGZ_TRAILER_SIZE);
+    zs.next_out = out;
+    zs.avail_out = uInt(usize);
+    int res = inflate(&zs, Z_FINISH);
+    size_t ulen = zs.total_out;
+    inflateEnd(&zs);
+    const unsigned char *trailer = in + csize - BGZ_TRAILER_SIZE;
+    if (res != Z_STREAM_END || ulen != usize
+	|| bgz_get_le32(trailer + 4) != usize
+	|| bgz_get_le32(trailer) != crc32(0L, out, uInt(usize)))
+	return 1;
+    return 0;
+}
+
+/* Compress and write out the data in ubuf. */
+static Rboolean bgz_flush(Rbgzfileconn bgz)
+{
+    size_t nb = (bgz->ulen + BGZ_BLOCK_SIZE - 1)/BGZ_BLOCK_SIZE;
+    int failed = 0;
+    if (nb == 0 && bgz->nblocks == 0)
+	nb = 1; /* an empty file is still one (empty) member */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(bgz->nthreads) reduction(|:failed)
+#endif
+    for (size_t i = 0; i < nb; i++) {
+	size_t start = i * BGZ_BLOCK_SIZE;
+	size_t n = bgz->ulen - start;
+	if (n > BGZ_BLOCK_SIZE) n = BGZ_BLOCK_SIZE;
+	bgz->clen[i] = bgz_deflate(bgz->ubuf + start, n,
+				   bgz->cbuf + i * bgz->cbufsize,
+				   bgz->cbufsize, bgz->compress);
+	failed |= (bgz->clen[i] == 0);
+    }
+    if (failed)
+	return FALSE;
+    for (size_t i = 0; i < nb; i++)
+	if (fwrite(bgz->cbuf + i * bgz->cbufsize, 1, bgz->clen[i], bgz->fp)
+	    != bgz->clen[i])
+	    return FALSE;
+    bgz->ustart += bgz->ulen;
+    bgz->ulen = 0;
+    bgz->nblocks += nb;
+    return TRUE;
+}
+
+/* Read and decompress the next batch of blocks into ubuf.  Returns
+   the number of bytes now available. */
+static size_t bgz_fill(Rconnection con)
+{
+    Rbgzfileconn bgz = static_cast<Rbgzfileconn>(con->connprivate);
+    size_t first = bgz->next;
+    size_t nb = bgz->nblocks - first;
+    if (nb > size_t(bgz->nthreads)) nb = bgz->nthreads;
+    bgz->ustart += bgz->ulen;
+    bgz->ulen = bgz->upos = 0;
+    if (nb == 0)
+	return 0;
+    for (size_t i = 0; i < nb; i++) {
+	bgzblock *b = bgz->index + first + i;
+	if (f_seek(bgz->fp, b->offset, SEEK_SET) != 0
+	    || fread(bgz->cbuf + i * bgz->cbufsize, 1, b->csize, bgz->fp)
+	    != b->csize)
+	    error(_("error reading from block-compressed file '%s'"),
+		  R_ExpandFileName(con->description));
+    }
+    int failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(bgz->nthreads) reduction(|:failed)
+#endif
+    for (size_t i = 0; i < nb; i++) {
+	bgzblock *b = bgz->index + first + i;
+	failed |= bgz_inflate(bgz->cbuf + i * bgz->cbufsize, b->csize,
+			      bgz->ubuf + size_t(b->start - bgz->index[first].start),
+			      b->usize);
+    }
+    if (failed)
+	error(_("block-compressed file '%s' is corrupt"),
+	      R_ExpandFileName(con->description));
+    bgz->ustart = bgz->index[first].start;
+    bgz->ulen = size_t(bgz->index[first + nb - 1].start
+		       + bgz->index[first + nb - 1].usize - bgz->ustart);
+    bgz->next = first + nb;
+    return bgz->ulen;
+}
+
+/* Scan the member headers of an open file to build its index. */
+static Rboolean bgz_build_index(Rbgzfileconn bgz)
+{
+    unsigned char h[BGZ_HEADER_SIZE];
+    size_t nalloc = 0;
+    OFF_T offset = 0;
+    double start = 0;
+    bgz->nblocks = 0;
+    for (;;) {
+	size_t res = fread(h, 1, BGZ_HEADER_SIZE, bgz->fp);
+	if (res == 0 && feof(bgz->fp))
+	    break;
+	bgzblock b;
+	if (res != BGZ_HEADER_SIZE || !bgz_parse_header(h, &b.csize, &b.usize))
+	    return FALSE;
+	if (bgz->nblocks == nalloc) {
+	    nalloc = nalloc ? 2 * nalloc : 64;
+	    bgzblock *index = static_cast<bgzblock*>(
+		realloc(bgz->index, nalloc * sizeof(bgzblock)));
+	    if (!index)
+		return FALSE;
+	    bgz->index = index;
+	}
+	b.offset = offset;
+	b.start = start;
+	bgz->index[bgz->nblocks++] = b;
+	offset += b.csize;
+	start += b.usize;
+	if (f_seek(bgz->fp, offset, SEEK_SET) != 0)
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+static void bgzfile_free(Rbgzfileconn bgz)
+{
+    free(bgz->cbuf); bgz->cbuf = nullptr;
+    free(bgz->clen); bgz->clen = nullptr;
+    free(bgz->ubuf); bgz->ubuf = nullptr;
+    free(bgz->index); bgz->index = nullptr;
+}
+
+static Rboolean bgzfile_open(Rconnection con)
+{
+    Rbgzfileconn bgz = static_cast<Rbgzfileconn>(con->connprivate);
+    char mode[] = "rb";
+    const char *path = R_ExpandFileName(con->description);
+
+    if (con->mode[0] == 'a') {
+	warning(_("bgzfile connections cannot be opened for appending"));
+	return FALSE;
+    }
+    con->canwrite = CXXRCONSTRUCT(Rboolean, con->mode[0] == 'w');
+    con->canread = CXXRCONSTRUCT(Rboolean, !con->canwrite);
+    mode[0] = con->mode[0];
+    errno = 0; /* precaution */
+    bgz->fp = R_fopen(path, mode);
+    if (!bgz->fp) {
+	warning(_("cannot open compressed file '%s', probable reason '%s'"),
+		path, strerror(errno));
+	return FALSE;
+    }
+    bgz->nthreads = 1;
+#ifdef _OPENMP
+    if (R_num_math_threads > 1)
+	bgz->nthreads = R_num_math_threads;
+#endif
+    bgz->cbufsize = BGZ_HEADER_SIZE + compressBound(BGZ_BLOCK_SIZE)
+	+ BGZ_TRAILER_SIZE;
+    bgz->cbuf = static_cast<unsigned char*>(malloc(bgz->nthreads * bgz->cbufsize));
+    bgz->clen = static_cast<size_t*>(malloc(bgz->nthreads * sizeof(size_t)));
+    bgz->ubuf = static_cast<unsigned char*>(malloc(bgz->nthreads * size_t(BGZ_BLOCK_SIZE)));
+    bgz->index = nullptr;
+    bgz->ulen = bgz->upos = 0;
+    bgz->ustart = 0;
+    bgz->nblocks = bgz->next = 0;
+    if (!bgz->cbuf || !bgz->clen || !bgz->ubuf) {
+	bgzfile_free(bgz);
+	fclose(bgz->fp);
+	warning(_("allocation of bgzfile buffers failed"));
+	return FALSE;
+    }
+    if (con->canread && !bgz_build_index(bgz)) {
+	bgzfile_free(bgz);
+	fclose(bgz->fp);
+	warning(_("file '%s' appears not to be a block-compressed gzip file"),
+		path);
+	return FALSE;
+    }
+    con->isopen = TRUE;
+    con->text = strchr(con->mode, 'b') ? FALSE : TRUE;
+    set_iconv(con);
+    con->save = -1000;
+    return TRUE;
+}
+
+static void bgzfile_close(Rconnection con)
+{
+    Rbgzfileconn bgz = static_cast<Rbgzfileconn>(con->connprivate);
+    Rboolean ok = TRUE;
+    if (con->canwrite)
+	ok = bgz_flush(bgz);
+    bgzfile_free(bgz);
+    if (fclose(bgz->fp) != 0)
+	ok = FALSE;
+    con->isopen = FALSE;
+    if (!ok)
+	warning(_("error writing block-compressed file '%s'"),
+		R_ExpandFileName(con->description));
+}
+
+static size_t bgzfile_read(void *ptr, size_t size, size_t nitems,
+			   Rconnection con)
+{
+    Rbgzfileconn bgz = static_cast<Rbgzfileconn>(con->connprivate);
+    size_t n = size * nitems, done = 0;
+    while (done < n) {
+	if (bgz->upos == bgz->ulen && bgz_fill(con) == 0)
+	    break;
+	size_t m = bgz->ulen - bgz->upos;
+	if (m > n - done) m = n - done;
+	memcpy(static_cast<char*>(ptr) + done, bgz->ubuf + bgz->upos, m);
+	bgz->upos += m;
+	done += m;
+    }
+    return done / size;
+}
+
+static int bgzfile_fgetc_internal(Rconnection con)
+{
+    unsigned char c;
+    return bgzfile_read(&c, 1, 1, con) == 1 ? c : R_EOF;
+}
+
+static size_t bgzfile_write(const void *ptr, size_t size, size_t nitems,
+			    Rconnection con)
+{
+    Rbgzfileconn bgz = static_cast<Rbgzfileconn>(con->connprivate);
+    size_t n = size * nitems, done = 0;
+    size_t cap = bgz->nthreads * size_t(BGZ_BLOCK_SIZE);
+    while (done < n) {
+	size_t m = cap - bgz->ulen;
+	if (m > n - done) m = n - done;
+	memcpy(bgz->ubuf + bgz->ulen, static_cast<const char*>(ptr) + done, m);
+	bgz->ulen += m;
+	done += m;
+	if (bgz->ulen == cap && !bgz_flush(bgz))
+	    return 0;
+    }
+    return nitems;
+}
+
+/* Reading seeks via the index, so only the blocks at the new position
+   are decompressed.  Writing cannot seek. */
+static double bgzfile_seek(Rconnection con, double where, int origin, int rw)
+{
+    Rbgzfileconn bgz = static_cast<Rbgzfileconn>(con->connprivate);
+    double pos = bgz->ustart + (con->canread ? bgz->upos : bgz->ulen);
+
+    if (ISNA(where)) return pos;
+    if (con->canwrite) {
+	warning(_("seek on a bgzfile connection is only possible when reading"));
+	return pos;
+    }
+    double total = bgz->nblocks
+	? bgz->index[bgz->nblocks - 1].start + bgz->index[bgz->nblocks - 1].usize
+	: 0;
+    switch(origin) {
+    case 2: where += pos; break;
+    case 3: where += total; break;
+    default: break;
+    }
+    if (where < 0) where = 0;
+    if (where > total) where = total;
+    if (where >= bgz->ustart && where < bgz->ustart + bgz->ulen) {
+	bgz->upos = size_t(where - bgz->ustart);
+	return pos;
+    }
+    /* Find the last block starting at or before 'where'. */
+    size_t lo = 0, hi = bgz->nblocks;
+    while (hi - lo > 1) {
+	size_t mid = (lo + hi)/2;
+	if (bgz->index[mid].start <= where) lo = mid; else hi = mid;
+    }
+    bgz->next = lo;
+    bgz->ustart = 0;
+    bgz->ulen = bgz->upos = 0;
+    if (bgz_fill(con) > 0)
+	bgz->upos = size_t(where - bgz->ustart);
+    else
+	bgz->ustart = total;
+    return pos;
+}
+
+static Rconnection newbgzfile(const char *description, const char *mode,
+			      int compress)
+{
+    Rconnection newconn;
+    newconn = static_cast<Rconnection>( malloc(sizeof(struct Rconn)));
+    if(!newconn) error(_("allocation of bgzfile connection failed"));
+    newconn->connclass = static_cast<char *>( malloc(strlen("bgzfile") + 1));
+    if(!newconn->connclass) {
+	free(newconn);
+	error(_("allocation of bgzfile connection failed"));
+    }
+    strcpy(newconn->connclass, "bgzfile");
+    newconn->description = static_cast<char *>( malloc(strlen(description) + 1));
+    if(!newconn->description) {
+	free(newconn->connclass); free(newconn);
+	error(_("allocation of bgzfile connection failed"));
+    }
+    init_con(newconn, description, CE_NATIVE, mode);
+
+    newconn->canseek = TRUE;
+    newconn->open = &bgzfile_open;
+    newconn->close = &bgzfile_close;
+    newconn->vfprintf = &dummy_vfprintf;
+    newconn->fgetc_internal = &bgzfile_fgetc_internal;
+    newconn->fgetc = &dummy_fgetc;
+    newconn->seek = &bgzfile_seek;
+    newconn->fflush = &null_fflush;
+    newconn->read = &bgzfile_read;
+    newconn->write = &bgzfile_write;
+    newconn->connprivate = CXXRNOCAST(void *) malloc(sizeof(struct bgzfileconn));
+    if(!newconn->connprivate) {
+	free(newconn->description); free(newconn->connclass); free(newconn);
+	error(_("allocation of bgzfile connection failed"));
+    }
+    static_cast<Rbgzfileconn>(newconn->connprivate)->compress = compress;
+    return newconn;
+}
+
+/* op 0 is gzfile, 1 is bzfile, 2 is xv/lzma, 3 is bgzfile */
 SEXP attribute_hidden do_gzfile(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
 {
     SEXP sfile, sopen, ans, connclass, enc;
@@ -2031,7 +2624,7 @@ SEXP attribute_hidden do_gzfile(/*const*/ CXXR::Expression* call, const CXXR::Bu
     if(!isString(enc) || Rf_length(enc) != 1 ||
        strlen(CHAR(STRING_ELT(enc, 0))) > 100) /* ASCII */
 	error(_("invalid '%s' argument"), "encoding");
-    if(type < 2) {
+    if(type < 2 || type == 3) {
 	compress = asInteger(args[3]);
 	if(compress == NA_LOGICAL || compress < 0 || compress > 9)
 	    error(_("invalid '%s' argument"), "compress");
@@ -2073,6 +2666,9 @@ SEXP attribute_hidden do_gzfile(/*const*/ CXXR::Expression* call, const CXXR::Bu
     case 2:
 	con = newxzfile(file, strlen(open) ? open : "rb", subtype, compress);
 	break;
+    case 3:
+	con = newbgzfile(file, strlen(open) ? open : "rb", compress);
+	break;
     }
     ncon = NextConnection();
     Connections[ncon] = con;
@@ -2105,6 +2701,9 @@ SEXP attribute_hidden do_gzfile(/*const*/ CXXR::Expression* call, const CXXR::Bu
     case 2:
 	SET_STRING_ELT(connclass, 0, mkChar("xzfile"));
 	break;
+    case 3:
+	SET_STRING_ELT(connclass, 0, mkChar("bgzfile"));
+	break;
     }
     SET_STRING_ELT(connclass, 1, mkChar("connection"));
     classgets(ans, connclass);
@@ -3496,7 +4095,10 @@ int Rconn_fgetc(Rconnection con)
 	    con->save = -1000;
 	    return c;
 	}
-	c = con->fgetc(con);
+	if (con->buff_pos < con->buff_stored_len && !con->inconv)
+	    c = con->buff[con->buff_pos++];
+	else
+	    c = con->fgetc(con);
 	if (c == '\r') {
 	    c = con->fgetc(con);
 	    if (c != '\n') {
@@ -3565,6 +4167,112 @@ int Rconn_printf(Rconnection con, const char *format, ...)
     return res;
 }
 
+/* ------------------- buffered output --------------------- */
+
+static void outbuf_emit(Rconnection con, const char *s, size_t n)
+{
+    if (n == 0) return;
+    /* these printf methods amount to con->write when not re-encoding */
+    if (!con->outconv && (con->vfprintf == &dummy_vfprintf
+			  || con->vfprintf == &file_vfprintf)) {
+	if (con->write(s, 1, n, con) != n)
+	    error(_("error writing to connection"));
+    } else {
+	const size_t chunk = 1 << 30; /* for %.*s */
+	for (size_t done = 0; done < n; done += chunk)
+	    Rconn_printf(con, "%.*s", int(std::min(chunk, n - done)),
+			 s + done);
+    }
+}
+
+void Rconn_outbuf_init(Rconn_outbuf *ob, Rconnection con)
+{
+    ob->con = con;
+    ob->len = 0;
+}
+
+void Rconn_outbuf_flush(Rconn_outbuf *ob)
+{
+    size_t len = ob->len;
+    ob->len = 0;
+    outbuf_emit(ob->con, ob->data, len);
+}
+
+void Rconn_outbuf_write(Rconn_outbuf *ob, const char *s, size_t n)
+{
+    if (ob->len + n > RCONN_OUTBUF_SIZE) {
+	Rconn_outbuf_flush(ob);
+	if (n > RCONN_OUTBUF_SIZE / 2) {
+	    outbuf_emit(ob->con, s, n);
+	    return;
+	}
+    }
+    memcpy(ob->data + ob->len, s, n);
+    ob->len += n;
+}
+
+/* Writes the decimal digits of v backwards, ending at 'end'. */
+static char *outbuf_digits(char *end, unsigned long long v)
+{
+    do {
+	*--end = char('0' + v % 10);
+	v /= 10;
+    } while (v);
+    return end;
+}
+
+/* x as formatted by EncodeInteger(x, 0) */
+void Rconn_outbuf_int(Rconn_outbuf *ob, int x)
+{
+    if (x == NA_INTEGER) {
+	Rconn_outbuf_write(ob, CHAR(R_print.na_string), R_print.na_width);
+	return;
+    }
+    char buf[16], *end = buf + sizeof buf;
+    long long v = x;
+    char *p = outbuf_digits(end, (unsigned long long)(v < 0 ? -v : v));
+    if (v < 0) *--p = '-';
+    Rconn_outbuf_write(ob, p, end - p);
+}
+
+/* Writes x as formatReal() and EncodeReal0() would format it on its
+   own, with 'dec' as the decimal point, if x is a whole number of at
+   most R_print.digits significant digits, so that the choice between
+   fixed and scientific notation is the only one needed.  Returns
+   FALSE, writing nothing, for any other x. */
+Rboolean Rconn_outbuf_real(Rconn_outbuf *ob, double x, char dec)
+{
+    if (!R_FINITE(x) || x != trunc(x) || fabs(x) >= 1e15
+	|| R_print.digits < 15)
+	return FALSE;
+    char buf[32], *end = buf + sizeof buf;
+    bool neg = x < 0;
+    char *p = outbuf_digits(end, (unsigned long long)(neg ? -x : x));
+    int n = int(end - p), nsig = n;
+    while (nsig > 1 && p[nsig - 1] == '0') nsig--;
+    if (p[0] == '0') neg = false; /* -0 */
+    /* widths in F and E formats: see formatReal() */
+    int wF = neg + n, d = nsig - 1, wE = neg + (d > 0) + d + 5;
+    if (wF <= wE + R_print.scipen) {
+	if (neg) *--p = '-';
+	Rconn_outbuf_write(ob, p, end - p);
+    } else {
+	char e[32], *q = e;
+	if (neg) *q++ = '-';
+	*q++ = p[0];
+	if (d > 0) {
+	    *q++ = dec;
+	    memcpy(q, p + 1, d);
+	    q += d;
+	}
+	*q++ = 'e'; *q++ = '+';
+	*q++ = char('0' + (n - 1) / 10);
+	*q++ = char('0' + (n - 1) % 10);
+	Rconn_outbuf_write(ob, e, q - e);
+    }
+    return TRUE;
+}
+
 /* readLines(con = stdin(), n = 1, ok = TRUE, warn = TRUE) */
 #define BUF_SIZE 1000
 SEXP attribute_hidden do_readLines(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
@@ -3640,11 +4348,52 @@ SEXP attribute_hidden do_readLines(/*const*/ CXXR::Expression* call, const CXXR:
 		PROTECT(ans = ans2);
 	    }
 	    nbuf = 0;
-	    while((c = Rconn_fgetc(con)) != R_EOF) {
+	    for(;;) {
+		const char *data;
+		int len = Rconn_peek(con, &data);
+		if(len == 0) {
+		    c = R_EOF;
+		    break;
+		}
+		if(len > 0) {
+		    /* copy the run up to the newline, or up to a CR
+		       which Rconn_fgetc maps */
+		    const char *nl =
+			static_cast<const char *>(memchr(data, '\n', len));
+		    if(nl) len = int(nl - data);
+		    const char *cr =
+			static_cast<const char *>(memchr(data, '\r', len));
+		    if(cr) len = int(cr - data);
+		    while(nbuf + len >= buf_size) {
+			buf_size *= 2;
+			char* tmp  = static_cast<char *>( realloc(buf, buf_size));
+			if(!tmp) {
+			    free(buf);
+			    error(_("cannot allocate buffer in readLines"));
+			} else buf = tmp;
+		    }
+		    if(skipNul) {
+			for(int j = 0; j < len; j++)
+			    if(data[j]) buf[nbuf++] = data[j];
+		    } else {
+			memcpy(buf + nbuf, data, len);
+			nbuf += len;
+		    }
+		    if(cr) Rconn_consume(con, len);
+		    else {
+			Rconn_consume(con, nl ? len + 1 : len);
+			if(nl) {
+			    c = '\n';
+			    break;
+			}
+			continue;
+		    }
+		}
+		if((c = Rconn_fgetc(con)) == R_EOF) break;
 		if(nbuf == buf_size-1) {  /* need space for the terminator */
 		    buf_size *= 2;
 		    char* tmp  = static_cast<char *>( realloc(buf, buf_size));
-		    if(!buf) {
+		    if(!tmp) {
 			free(buf);
 			error(_("cannot allocate buffer in readLines"));
 		    } else buf = tmp;
@@ -3742,23 +4491,33 @@ SEXP attribute_hidden do_writelines(/*const*/ CXXR::Expression* call, const CXXR
 	/* New for 2.7.0: split the output if sink was split.
 	   It would be slightly simpler just to call Rvprintf if the
 	   connection was stdout(), but this way is more efficent */
+	Rconn_outbuf ob;
+	size_t nsep = strlen(ssep);
 	if(con_num == R_OutputCon) {
 	    int j = 0;
 	    Rconnection con0;
 	    do {
 		con0 = getConnection(con_num);
-		for(R_xlen_t i = 0; i < xlength(text); i++)
-		    Rconn_printf(con0, "%s%s",
-				 useBytes ? CHAR(STRING_ELT(text, i)) :
-				 translateChar0(STRING_ELT(text, i)), ssep);
+		Rconn_outbuf_init(&ob, con0);
+		for(R_xlen_t i = 0; i < xlength(text); i++) {
+		    Rconn_outbuf_puts(&ob, useBytes ?
+				      CHAR(STRING_ELT(text, i)) :
+				      translateChar0(STRING_ELT(text, i)));
+		    Rconn_outbuf_write(&ob, ssep, nsep);
+		}
+		Rconn_outbuf_flush(&ob);
 		con0->fflush(con0);
 		con_num = getActiveSink(j++);
 	    } while (con_num > 0);
 	} else {
-	    for(R_xlen_t i = 0; i < xlength(text); i++)
-		Rconn_printf(con, "%s%s",
-			     useBytes ? CHAR(STRING_ELT(text, i)) :
-			     translateChar0(STRING_ELT(text, i)), ssep);
+	    Rconn_outbuf_init(&ob, con);
+	    for(R_xlen_t i = 0; i < xlength(text); i++) {
+		Rconn_outbuf_puts(&ob, useBytes ?
+				  CHAR(STRING_ELT(text, i)) :
+				  translateChar0(STRING_ELT(text, i)));
+		Rconn_outbuf_write(&ob, ssep, nsep);
+	    }
+	    Rconn_outbuf_flush(&ob);
 	}
     } catch (...) {
 	if (!wasopen && con->isopen)
@@ -5753,7 +6512,7 @@ SEXP R_decompress2(SEXP in, Rboolean *err)
     if(TYPEOF(in) != RAWSXP)
 	error("R_decompress2 requires a raw vector");
     inlen = LENGTH(in);
-    outlen = uiSwap(static_cast<unsigned int>(*p));
+    outlen = uiSwap(*(reinterpret_cast<unsigned int *>( p)));
     buf = R_alloc(outlen, sizeof(char));
     type = p[4];
     if (type == '2') {
@@ -5958,6 +6717,69 @@ SEXP R_decompress3(SEXP in, Rboolean *err)
     return ans;
 }
 
+/* Decompresses 'inlen' bytes written by R_compress<method>() into
+   'out', which holds the 'outlen' bytes given by their header.  Unlike
+   R_decompress<method>() this neither allocates nor signals, so may be
+   used from threads other than the main one: it returns FALSE if the
+   data are corrupt. */
+attribute_hidden
+Rboolean R_decompressBuffer(int method, const unsigned char *in,
+			    size_t inlen, unsigned char *out, size_t outlen)
+{
+    size_t skip = (method == 1) ? 4 : 5;
+    if (inlen < skip) return FALSE;
+    unsigned char type = (method == 1) ? '1' : in[4];
+    const unsigned char *p = in + skip;
+    inlen -= skip;
+
+    switch(type) {
+    case 'Z':
+    {
+	/* as init_filters(), but not touching its statics */
+	lzma_options_lzma opt_lzma;
+	lzma_filter filt[2];
+	if (method != 3 || lzma_lzma_preset(&opt_lzma, 6)) return FALSE;
+	filt[0].id = LZMA_FILTER_LZMA2;
+	filt[0].options = &opt_lzma;
+	filt[1].id = LZMA_VLI_UNKNOWN;
+	lzma_stream strm = LZMA_STREAM_INIT;
+	if (lzma_raw_decoder(&strm, filt) != LZMA_OK) return FALSE;
+	strm.next_in = p;
+	strm.avail_in = inlen;
+	strm.next_out = out;
+	strm.avail_out = outlen;
+	lzma_ret ret = lzma_code(&strm, LZMA_RUN);
+	Rboolean ok = CXXRCONSTRUCT(Rboolean,
+				    (ret == LZMA_OK || ret == LZMA_STREAM_END)
+				    && strm.avail_out == 0);
+	lzma_end(&strm);
+	return ok;
+    }
+    case '2':
+    {
+	unsigned int outl = static_cast<unsigned int>(outlen);
+	int res = BZ2_bzBuffToBuffDecompress(reinterpret_cast<char *>(out),
+					     &outl,
+					     reinterpret_cast<char *>(const_cast<unsigned char *>(p)),
+					     static_cast<unsigned int>(inlen),
+					     0, 0);
+	return CXXRCONSTRUCT(Rboolean, res == BZ_OK && outl == outlen);
+    }
+    case '1':
+    {
+	uLong outl = uLong(outlen);
+	int res = uncompress(out, &outl, p, uLong(inlen));
+	return CXXRCONSTRUCT(Rboolean, res == Z_OK && outl == outlen);
+    }
+    case '0':
+	if (inlen != outlen) return FALSE;
+	memcpy(out, p, outlen);
+	return TRUE;
+    default:
+	return FALSE;
+    }
+}
+
 SEXP attribute_hidden
 do_memCompress(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
 {
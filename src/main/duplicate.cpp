@@ -31,6 +31,8 @@
 
 #include "Defn.h"
 
+#include <algorithm>
+
 #include "CXXR/DottedArgs.hpp"
 #include "CXXR/GCStackRoot.hpp"
 
@@ -66,9 +68,83 @@ SEXP duplicate(SEXP s){
     return t;
 }
 
+/* Give the copy t the attributes of s.  The attribute list itself is
+   rebuilt, but its values are shared, and so marked as such. */
+static void shallow_duplicate_attrib(SEXP t, SEXP s)
+{
+    const PairList* attribs = s->attributes();
+    if (attribs) {
+	for (const PairList* a = attribs; a; a = a->tail())
+	    lazy_duplicate(a->car());
+	t->setAttributes(attribs);
+    }
+    t->setS4Object(s->isS4Object());
+}
+
+/* Copy only the top level of s: a list gets a new spine whose
+   elements are shared with s, and a vector of any other type a copy
+   of its data.  Attribute values are shared in both cases.  Shared
+   objects are marked NAMED = 2, so the copy-on-write checks made by
+   the assignment code duplicate them if and when they are modified;
+   in particular x[[i]][j] <- v then copies just x's spine and x[[i]].
+   Objects of other types are copied in full, as by duplicate(). */
 SEXP shallow_duplicate(SEXP s) {
-    // TODO(kmillar): implement shallow duplicates.
-    return duplicate(s);
+    if (!s) return nullptr;
+    GCStackRoot<> srt(s);
+    GCStackRoot<> t;
+    R_xlen_t n;
+    switch (TYPEOF(s)) {
+    case VECSXP:
+	n = XLENGTH(s);
+	t = allocVector(VECSXP, n);
+	for (R_xlen_t i = 0; i < n; i++)
+	    SET_VECTOR_ELT(t, i, lazy_duplicate(VECTOR_ELT(s, i)));
+	break;
+    case EXPRSXP:
+	n = XLENGTH(s);
+	t = allocVector(EXPRSXP, n);
+	for (R_xlen_t i = 0; i < n; i++)
+	    SET_XVECTOR_ELT(t, i, lazy_duplicate(XVECTOR_ELT(s, i)));
+	break;
+    case STRSXP:
+	n = XLENGTH(s);
+	t = allocVector(STRSXP, n);
+	for (R_xlen_t i = 0; i < n; i++)
+	    SET_STRING_ELT(t, i, STRING_ELT(s, i));
+	break;
+    case LGLSXP:
+	n = XLENGTH(s);
+	t = allocVector(LGLSXP, n);
+	std::copy(LOGICAL(s), LOGICAL(s) + n, LOGICAL(t));
+	break;
+    case INTSXP:
+	n = XLENGTH(s);
+	t = allocVector(INTSXP, n);
+	std::copy(INTEGER(s), INTEGER(s) + n, INTEGER(t));
+	break;
+    case REALSXP:
+	n = XLENGTH(s);
+	t = allocVector(REALSXP, n);
+	std::copy(REAL(s), REAL(s) + n, REAL(t));
+	break;
+    case CPLXSXP:
+	n = XLENGTH(s);
+	t = allocVector(CPLXSXP, n);
+	std::copy(COMPLEX(s), COMPLEX(s) + n, COMPLEX(t));
+	break;
+    case RAWSXP:
+	n = XLENGTH(s);
+	t = allocVector(RAWSXP, n);
+	std::copy(RAW(s), RAW(s) + n, RAW(t));
+	break;
+    default:
+	return duplicate(s);
+    }
+#ifdef R_PROFILING
+    duplicate_counter++;
+#endif
+    shallow_duplicate_attrib(t, s);
+    return t;
 }
 
 SEXP lazy_duplicate(SEXP s) {
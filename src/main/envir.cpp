@@ -752,6 +752,10 @@ SEXP attribute_hidden do_list2env(/*const*/ CXXR::Expression* call, const CXXR::
     envir = args[1];
     if (TYPEOF(envir) != ENVSXP)
 	error(_("'envir' argument must be an environment"));
+    if (n && envir != R_EmptyEnv) {
+	Frame* frame = SEXP_downcast<Environment*>(envir)->frame();
+	frame->reserve(frame->size() + n);
+    }
 
     for(int i = 0; i < n; i++) {
 	SEXP name = installTrChar(STRING_ELT(xnms, i));
@@ -941,19 +945,17 @@ SEXP attribute_hidden do_get(/*const*/ CXXR::Expression* call, const CXXR::Built
 }
 #undef GET_VALUE
 
-static SEXP gfind(const char *name, SEXP env, SEXPTYPE mode,
+static SEXP gfind(SEXP t1, SEXP env, SEXPTYPE mode,
 		  SEXP ifnotfound, int inherits, SEXP enclos)
 {
-    SEXP rval, t1, R_fcall, var;
-
-    t1 = install(name);
+    SEXP rval, R_fcall, var;
 
     /* Search for the object - last arg is 1 to 'get' */
     rval = findVar1mode(t1, env, mode, inherits, CXXRTRUE);
 
     if (rval == R_UnboundValue) {
 	if( isFunction(ifnotfound) ) {
-	    PROTECT(var = mkString(name));
+	    PROTECT(var = ScalarString(PRINTNAME(t1)));
 	    PROTECT(R_fcall = LCONS(ifnotfound, CONS(var, R_NilValue)));
 	    rval = eval(R_fcall, enclos);
 	    UNPROTECT(2);
@@ -1021,16 +1023,20 @@ SEXP attribute_hidden do_mget(/*const*/ CXXR::Expression* call, const CXXR::Buil
 
     PROTECT(ans = allocVector(VECSXP, nvals));
 
+    /* Usually a single mode applies to all the names: decode it once. */
+    SEXPTYPE gmode = ANYSXP;
     for(int i = 0; i < nvals; i++) {
-	SEXPTYPE gmode;
-	if (!strcmp(CHAR(STRING_ELT(args[2], i % nmode)), "function"))
-	    gmode = FUNSXP;
-	else {
-	    gmode = str2type(CHAR(STRING_ELT(args[2], i % nmode)));
-	    if(gmode == SEXPTYPE( (-1)))
-		error(_("invalid '%s' argument"), "mode");
+	if (i < nmode) {
+	    const char *cmode = CHAR(STRING_ELT(mode, i));
+	    if (!strcmp(cmode, "function"))
+		gmode = FUNSXP;
+	    else {
+		gmode = str2type(cmode);
+		if(gmode == SEXPTYPE( (-1)))
+		    error(_("invalid '%s' argument"), "mode");
+	    }
 	}
-	SEXP ans_i = gfind(translateChar(STRING_ELT(x, i % nvals)), env,
+	SEXP ans_i = gfind(installTrChar(STRING_ELT(x, i)), env,
                            gmode, VECTOR_ELT(ifnotfound, i % nifnfnd),
                            ginherits, rho);
 	SET_VECTOR_ELT(ans, i, lazy_duplicate(ans_i));
@@ -1216,6 +1222,7 @@ SEXP attribute_hidden do_attach(/*const*/ CXXR::Expression* call, const CXXR::Bu
 	    if (!names || elements->size() != names->size()) {
 		error(_("all elements of a list must be named"));
 	    }
+	    frame->reserve(length);
 	    for (size_t i = 0; i < length; ++i) {
 		if (!(*names)[i]) {
 		    error(_("all elements of a list must be named"));
@@ -1296,48 +1303,6 @@ SEXP attribute_hidden do_search(/*const*/ CXXR::Expression* call, const CXXR::Bu
 
 */
 
-static int FrameSize(SEXP frame, int all)
-{
-    int count = 0;
-    while (frame != R_NilValue) {
-	if ((all || CHAR(PRINTNAME(TAG(frame)))[0] != '.') &&
-				      CAR(frame) != R_UnboundValue)
-	    count += 1;
-	frame = CDR(frame);
-    }
-    return count;
-}
-
-static void FrameNames(SEXP frame, int all, SEXP names, int *indx)
-{
-    while (frame != R_NilValue) {
-	if ((all || CHAR(PRINTNAME(TAG(frame)))[0] != '.') &&
-				      CAR(frame) != R_UnboundValue) {
-	    SET_STRING_ELT(names, *indx, PRINTNAME(TAG(frame)));
-	    (*indx)++;
-	}
-	frame = CDR(frame);
-    }
-}
-
-static void FrameValues(SEXP frame, int all, SEXP values, int *indx)
-{
-    while (frame != R_NilValue) {
-	if ((all || CHAR(PRINTNAME(TAG(frame)))[0] != '.') &&
-				      CAR(frame) != R_UnboundValue) {
-	    SEXP value = CAR(frame);
-	    if (TYPEOF(value) == PROMSXP) {
-		PROTECT(value);
-		value = eval(value, R_GlobalEnv);
-		UNPROTECT(1);
-	    }
-	    SET_VECTOR_ELT(values, *indx, lazy_duplicate(value));
-	    (*indx)++;
-	}
-	frame = CDR(frame);
-    }
-}
-
 static bool BuiltinTest(const Symbol* sym, bool all, bool internal_only)
 {
     if ((sym->name()->c_str()[0] == '.') && !all) {
@@ -1464,7 +1429,7 @@ SEXP attribute_hidden do_env2list(/*const*/ CXXR::Expression* call, const CXXR::
 SEXP attribute_hidden do_eapply(SEXP call, SEXP op, SEXP args, SEXP rho)
 {
     SEXP env, ans, R_fcall, FUN, tmp, tmp2, ind;
-    int i, k, k2;
+    int i, k;
     int /* boolean */ all, useNms;
 
     checkArity(op, args);
@@ -1487,15 +1452,26 @@ SEXP attribute_hidden do_eapply(SEXP call, SEXP op, SEXP args, SEXP rho)
     useNms = asLogical(eval(CADDDR(args), rho));
     if (useNms == NA_LOGICAL) useNms = 0;
 
-    GCStackRoot<> framelist(FRAME(env));
-
-    k = FrameSize(framelist, all);
+    GCStackRoot<Frame> frame(SEXP_downcast<Environment*>(env)->frame());
+    std::vector<const Symbol*> syms = frame->symbols(all);
+    k = int(syms.size());
 
     PROTECT(ans  = allocVector(VECSXP, k));
     PROTECT(tmp2 = allocVector(VECSXP, k));
 
-    k2 = 0;
-    FrameValues(framelist, all, tmp2, &k2);
+    for (i = 0; i < k; i++) {
+	const Frame::Binding* bdg = frame->binding(syms[i]);
+	if (!bdg)
+	    continue;
+	/* unforcedValue() calls the function of an active binding */
+	SEXP value = bdg->unforcedValue();
+	if (TYPEOF(value) == PROMSXP) {
+	    PROTECT(value);
+	    value = eval(value, R_GlobalEnv);
+	    UNPROTECT(1);
+	}
+	SET_VECTOR_ELT(tmp2, i, lazy_duplicate(value));
+    }
 
     PROTECT(ind = allocVector(INTSXP, 1));
     /* tmp :=  `[`(<elist>, i) */
@@ -1504,7 +1480,7 @@ SEXP attribute_hidden do_eapply(SEXP call, SEXP op, SEXP args, SEXP rho)
     /* fcall :=  <FUN>( tmp, ... ) */
     PROTECT(R_fcall = LCONS(FUN, CONS(tmp, CONS(R_DotsSymbol, R_NilValue))));
 
-    for(i = 0; i < k2; i++) {
+    for(i = 0; i < k; i++) {
 	INTEGER(ind)[0] = i+1;
 	SEXP tmp = eval(R_fcall, rho);
 	if (MAYBE_REFERENCED(tmp))
@@ -1515,8 +1491,8 @@ SEXP attribute_hidden do_eapply(SEXP call, SEXP op, SEXP args, SEXP rho)
     if (useNms) {
 	SEXP names;
 	PROTECT(names = allocVector(STRSXP, k));
-	k = 0;
-	FrameNames(framelist, all, names, &k);
+	for (i = 0; i < k; i++)
+	    SET_STRING_ELT(names, i, PRINTNAME(const_cast<Symbol*>(syms[i])));
 
 	setAttrib(ans, R_NamesSymbol, names);
 	UNPROTECT(1);
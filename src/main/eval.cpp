@@ -750,7 +750,7 @@ static SEXP EnsureLocal(SEXP symbol, SEXP rho)
     if ((vl = Rf_findVarInFrame3(rho, symbol, TRUE)) != R_UnboundValue) {
 	vl = Rf_eval(symbol, rho);	/* for promises */
 	if(NAMED(vl) == 2) {
-	    vl = Rf_duplicate(vl);
+	    vl = Rf_shallow_duplicate(vl);
 	    Rf_defineVar(symbol, vl, rho);
 	    SET_NAMED(vl, 1);
 	}
@@ -761,7 +761,7 @@ static SEXP EnsureLocal(SEXP symbol, SEXP rho)
     if (vl == R_UnboundValue)
 	Rf_error(_("object '%s' not found"), CHAR(PRINTNAME(symbol)));
 
-    vl = Rf_duplicate(vl);
+    vl = Rf_shallow_duplicate(vl);
     Rf_defineVar(symbol, vl, rho);
     SET_NAMED(vl, 1);
     return vl;
@@ -1346,7 +1346,7 @@ static const char * const asym[] = {":=", "<-", "<<-", "="};
 	SEXP __lhs__ = (lhs); \
 	SEXP __v__ = CAR(__lhs__); \
 	if (NAMED(__v__) == 2) { \
-	    __v__ = Rf_duplicate(__v__); \
+	    __v__ = Rf_shallow_duplicate(__v__); \
 	    SET_NAMED(__v__, 1); \
 	    SETCAR(__lhs__, __v__); \
 	} \
@@ -3000,7 +3000,7 @@ static int tryAssignDispatch(CXXRCONST char *generic, SEXP call, SEXP lhs, SEXP
   SEXP lhs = GETSTACK(-2); \
   SEXP rhs = GETSTACK(-1); \
   if (NAMED(lhs) == 2) { \
-    lhs = Rf_duplicate(lhs); \
+    lhs = Rf_shallow_duplicate(lhs); \
     SETSTACK(-2, lhs); \
     SET_NAMED(lhs, 1); \
   } \
@@ -3058,7 +3058,7 @@ static int tryAssignDispatch(CXXRCONST char *generic, SEXP call, SEXP lhs, SEXP
 	SEXP call = VECTOR_ELT(constants, callidx); \
 	SEXP rhs = GETSTACK(-1); \
 	if (NAMED(lhs) == 2) { \
-	    lhs = Rf_duplicate(lhs); \
+	    lhs = Rf_shallow_duplicate(lhs); \
 	    SETSTACK(-2, lhs); \
 	    SET_NAMED(lhs, 1); \
 	} \
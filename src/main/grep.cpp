@@ -72,6 +72,11 @@ strsplit grep [g]sub [g]regexpr
 #include <wchar.h>
 #include <wctype.h>    /* for wctrans_t */
 
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
 /* As from TRE 0.8.0, tre.h replaces regex.h */
 #include <tre/tre.h>
 
@@ -132,6 +137,259 @@ static SEXP mkCharW(const wchar_t *wc)
 }
 
 
+/* Cache of compiled regular expressions.
+
+   Patterns compiled by TRE or PCRE are kept, keyed by the engine, the
+   compilation flags and the bytes of the pattern as passed to the
+   compiler (so after translation to the encoding used), in a list of
+   at most REGEX_CACHE_SIZE entries from which the least recently used
+   is dropped.  PCRE patterns which are studied use the JIT compiler
+   where PCRE supports it.  The cache is cleared when the locale's
+   character type changes, as TRE and pcre_maketables() depend on it.
+
+   Callers hold a shared pointer to the entry while they use it, as a
+   warning handler could run R code which evicts it.  A regex_t only
+   refers to TRE's compiled automaton, so may be copied from the entry
+   but must not be freed by the caller. */
+
+#define REGEX_CACHE_SIZE 64
+
+namespace {
+    enum RegexEngine { RE_TRE_BYTES, RE_TRE_NATIVE, RE_TRE_WIDE, RE_PCRE };
+
+    struct CachedRegex {
+	RegexEngine engine;
+	regex_t reg;
+	pcre *re_pcre;
+	pcre_extra *re_pe;
+	const unsigned char *tables;
+	bool compiled, studied;
+
+	CachedRegex(RegexEngine eng)
+	    : engine(eng), re_pcre(nullptr), re_pe(nullptr),
+	      tables(nullptr), compiled(false), studied(false)
+	{}
+
+	~CachedRegex()
+	{
+	    if (engine != RE_PCRE) {
+		if (compiled) tre_regfree(&reg);
+		return;
+	    }
+#ifdef PCRE_STUDY_JIT_COMPILE
+	    if (re_pe) pcre_free_study(re_pe);
+#else
+	    if (re_pe) pcre_free(re_pe);
+#endif
+	    if (re_pcre) pcre_free(re_pcre);
+	    if (tables)
+		pcre_free(CXXRNOCAST(void *)CXXRCCAST(unsigned char*, tables));
+	}
+    };
+
+    typedef std::shared_ptr<CachedRegex> RegexPtr;
+    typedef std::pair<std::string, RegexPtr> RegexCacheEntry;
+
+    std::list<RegexCacheEntry> s_regex_cache;  // most recently used first
+    std::unordered_map<std::string,
+		       std::list<RegexCacheEntry>::iterator> s_regex_index;
+    double s_regex_hits = 0, s_regex_misses = 0, s_regex_compile_time = 0;
+#ifdef PCRE_STUDY_JIT_COMPILE
+    /* The default 32Kb of machine stack is too little for some
+       patterns, so JIT-compiled ones use a stack of up to 16Mb, which
+       only commits what it uses.  Each thread matching needs its own. */
+    pcre_jit_stack *jitStack(void *)
+    {
+	static thread_local pcre_jit_stack *stack = nullptr;
+	if (!stack)
+	    stack = pcre_jit_stack_alloc(32*1024, 16*1024*1024);
+	return stack;
+    }
+#endif
+
+    std::string regexKey(RegexEngine engine, int cflags, const void *pat,
+			 size_t nbytes)
+    {
+	std::string key(reinterpret_cast<const char *>(&cflags),
+			sizeof(cflags));
+	key += char('0' + engine);
+	key.append(static_cast<const char *>(pat), nbytes);
+	return key;
+    }
+
+    RegexPtr findRegex(const std::string& key)
+    {
+	auto it = s_regex_index.find(key);
+	if (it == s_regex_index.end()) {
+	    s_regex_misses++;
+	    return RegexPtr();
+	}
+	s_regex_hits++;
+	s_regex_cache.splice(s_regex_cache.begin(), s_regex_cache, it->second);
+	return it->second->second;
+    }
+
+    void addRegex(const std::string& key, RegexPtr re)
+    {
+	if (s_regex_cache.size() >= REGEX_CACHE_SIZE) {
+	    s_regex_index.erase(s_regex_cache.back().first);
+	    s_regex_cache.pop_back();
+	}
+	s_regex_cache.push_front(RegexCacheEntry(key, re));
+	s_regex_index[key] = s_regex_cache.begin();
+    }
+
+    void studyRegex(CachedRegex *re)
+    {
+	const char *errorptr = nullptr;
+	double start = currentTime();
+#ifdef PCRE_STUDY_JIT_COMPILE
+	re->re_pe = pcre_study(re->re_pcre, PCRE_STUDY_JIT_COMPILE, &errorptr);
+	if (re->re_pe && !errorptr)
+	    pcre_assign_jit_stack(re->re_pe, jitStack, nullptr);
+#else
+	re->re_pe = pcre_study(re->re_pcre, 0, &errorptr);
+#endif
+	s_regex_compile_time += currentTime() - start;
+	re->studied = true;
+	if (errorptr)
+	    warning(_("PCRE pattern study error\n\t'%s'\n"), errorptr);
+    }
+}
+
+/* Number of threads to use for matching against n strings. */
+#define REGEX_PARALLEL_MIN 10000
+static int regexThreads(R_xlen_t n)
+{
+#ifdef _OPENMP
+    if (n >= REGEX_PARALLEL_MIN && R_num_math_threads > 1)
+	return R_num_math_threads;
+#endif
+    return 1;
+}
+
+/* Returns the TRE compilation of 'pat' (a char string for RE_TRE_BYTES
+   and RE_TRE_NATIVE, a wchar_t string for RE_TRE_WIDE), reporting an
+   error which quotes 'label' if it is invalid. */
+static RegexPtr tre_cached(RegexEngine engine, const void *pat, int cflags,
+			   const char *label)
+{
+    size_t nbytes = (engine == RE_TRE_WIDE)
+	? wcslen(static_cast<const wchar_t *>(pat)) * sizeof(wchar_t)
+	: strlen(static_cast<const char *>(pat));
+    std::string key = regexKey(engine, cflags, pat, nbytes);
+    RegexPtr re = findRegex(key);
+    if (re) return re;
+    re = std::make_shared<CachedRegex>(engine);
+    double start = currentTime();
+    int rc;
+    if (engine == RE_TRE_WIDE)
+	rc = tre_regwcomp(&re->reg, static_cast<const wchar_t *>(pat), cflags);
+    else if (engine == RE_TRE_BYTES)
+	rc = tre_regcompb(&re->reg, static_cast<const char *>(pat), cflags);
+    else
+	rc = tre_regcomp(&re->reg, static_cast<const char *>(pat), cflags);
+    s_regex_compile_time += currentTime() - start;
+    if (rc) reg_report(rc, &re->reg, label);
+    re->compiled = true;
+    addRegex(key, re);
+    return re;
+}
+
+/* Returns the PCRE compilation of 'pat', studied if 'study' is true,
+   reporting an error using 'errmsg' if it is invalid. */
+static RegexPtr pcre_cached(const char *pat, int cflags, bool study,
+			    const char *errmsg)
+{
+    std::string key = regexKey(RE_PCRE, cflags, pat, strlen(pat));
+    RegexPtr re = findRegex(key);
+    if (!re) {
+	int erroffset;
+	const char *errorptr;
+	re = std::make_shared<CachedRegex>(RE_PCRE);
+	double start = currentTime();
+	// PCRE docs say this is not needed, but it is on Windows
+	re->tables = pcre_maketables();
+	re->re_pcre = pcre_compile(pat, cflags, &errorptr, &erroffset,
+				   re->tables);
+	s_regex_compile_time += currentTime() - start;
+	if (!re->re_pcre) {
+	    if (errorptr)
+		warning(_("PCRE pattern compilation error\n\t'%s'\n\tat '%s'\n"),
+			errorptr, pat+erroffset);
+	    error(errmsg, pat);
+	}
+	addRegex(key, re);
+    }
+    if (study && !re->studied)
+	studyRegex(re.get());
+    return re;
+}
+
+void R_ClearRegexCache(void)
+{
+    s_regex_index.clear();
+    s_regex_cache.clear();
+}
+
+/* .Internal(regexCacheInfo(clear)) */
+SEXP attribute_hidden do_regexcacheinfo(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
+{
+    op->checkNumArgs(num_args, call);
+    int clear = asLogical(args[0]);
+    if (clear == NA_LOGICAL)
+	error(_("invalid '%s' argument"), "clear");
+    SEXP ans = PROTECT(allocVector(REALSXP, 5));
+    SEXP nm = allocVector(STRSXP, 5);
+    setAttrib(ans, R_NamesSymbol, nm);
+    const char *names[] = {"size", "max.size", "hits", "misses",
+			   "compile.time"};
+    for (int i = 0; i < 5; i++)
+	SET_STRING_ELT(nm, i, mkChar(names[i]));
+    REAL(ans)[0] = double(s_regex_cache.size());
+    REAL(ans)[1] = REGEX_CACHE_SIZE;
+    REAL(ans)[2] = s_regex_hits;
+    REAL(ans)[3] = s_regex_misses;
+    REAL(ans)[4] = s_regex_compile_time;
+    if (clear) {
+	R_ClearRegexCache();
+	s_regex_hits = s_regex_misses = s_regex_compile_time = 0;
+    }
+    UNPROTECT(1);
+    return ans;
+}
+
+/* Long needles go to glibc's memmem, which uses the Two-Way algorithm
+   and so is linear in the length of the haystack. */
+#define FIND_TWOWAY_MIN 32
+
+/* The first occurrence of the plen bytes at pat in the len bytes at s,
+   or nullptr.  Candidate positions are found by scanning for the first
+   byte of pat with memchr, which the C library vectorizes, and most
+   are rejected on the last byte before comparing the rest. */
+static const char *find_bytes(const char *s, size_t len,
+			      const char *pat, size_t plen)
+{
+    if (plen > len) return nullptr;
+    if (plen == 0) return s;
+    if (plen == 1)
+	return static_cast<const char *>(memchr(s, pat[0], len));
+#ifdef __GLIBC__
+    if (plen >= FIND_TWOWAY_MIN)
+	return static_cast<const char *>(memmem(s, len, pat, plen));
+#endif
+    const char last = pat[plen - 1];
+    const char *end = s + (len - plen) + 1; /* past the last start */
+    while (s < end) {
+	s = static_cast<const char *>(memchr(s, pat[0], end - s));
+	if (!s) return nullptr;
+	if (s[plen - 1] == last && memcmp(s + 1, pat + 1, plen - 2) == 0)
+	    return s;
+	s++;
+    }
+    return nullptr;
+}
+
 /* strsplit is going to split the strings in the first argument into
  * tokens depending on the second argument. The characters of the second
  * argument are used to split the first argument.  A list of vectors is
@@ -147,7 +405,6 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
     int fixed_opt, perl_opt, useBytes;
     char *pt = nullptr; wchar_t *wpt = nullptr;
     const char *buf, *split = "", *bufp;
-    const unsigned char *tables = nullptr;
     Rboolean use_UTF8 = FALSE, haveBytes = FALSE;
     const void *vmax, *vmax2;
     int nwarn = 0;
@@ -289,7 +546,7 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 		vmaxset(vmax2);
 	    }
 	} else if (fixed_opt) {
-	    const char *laststart, *ebuf;
+	    const char *ebuf, *q;
 	    if (useBytes)
 		split = CHAR(STRING_ELT(tok, itok));
 	    else if (use_UTF8) {
@@ -334,44 +591,26 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 		/* find out how many splits there will be */
 		size_t ntok = 0;
 		/* This is UTF-8 safe since it compares whole strings */
-		laststart = buf;
 		ebuf = buf + strlen(buf);
-		for (bufp = buf; bufp < ebuf; bufp++) {
-		    if ((slen == 1 && *bufp != *split) ||
-			(slen > 1 && strncmp(bufp, split, slen))) continue;
+		for (bufp = buf; (q = find_bytes(bufp, ebuf - bufp, split, slen));
+		     bufp = q + slen)
 		    ntok++;
-		    bufp += MAX(slen - 1, 0);
-		    laststart = bufp+1;
-		}
-		bufp = laststart;
 		SET_VECTOR_ELT(ans, i,
 			       t = allocVector(STRSXP, ntok + (*bufp ? 1 : 0)));
 		/* and fill with the splits */
-		laststart = bufp = buf;
+		bufp = buf;
 		pt = Realloc(pt, strlen(buf)+1, char);
 		for (size_t j = 0; j < ntok; j++) {
-		    /* This is UTF-8 safe since it compares whole
-		       strings, but <MBCS-FIXME> it would be more
-		       efficient to skip along by chars.
-		    */
-		    for (; bufp < ebuf; bufp++) {
-			if ((slen == 1 && *bufp != *split) ||
-			    (slen > 1 && strncmp(bufp, split, slen))) continue;
-			if (slen) {
-			    strncpy(pt, laststart, bufp - laststart);
-			    pt[bufp - laststart] = '\0';
-			} else {
-			    pt[0] = *bufp; pt[1] ='\0';
-			}
-			bufp += MAX(slen-1, 0);
-			laststart = bufp+1;
-			if (use_UTF8)
-			    SET_STRING_ELT(t, j, mkCharCE(pt, CE_UTF8));
-			else
-			    SET_STRING_ELT(t, j, markKnown(pt, STRING_ELT(x, i)));
-			break;
-		    }
-		    bufp = laststart;
+		    /* <MBCS-FIXME> in a non-UTF-8 MBCS a match can start
+		       inside a character. */
+		    q = find_bytes(bufp, ebuf - bufp, split, slen);
+		    memcpy(pt, bufp, q - bufp);
+		    pt[q - bufp] = '\0';
+		    bufp = q + slen;
+		    if (use_UTF8)
+			SET_STRING_ELT(t, j, mkCharCE(pt, CE_UTF8));
+		    else
+			SET_STRING_ELT(t, j, markKnown(pt, STRING_ELT(x, i)));
 		}
 		if (*bufp) {
 		    if (use_UTF8)
@@ -384,8 +623,7 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 	} else if (perl_opt) {
 	    pcre *re_pcre;
 	    pcre_extra *re_pe;
-	    int erroffset, ovector[30];
-	    const char *errorptr;
+	    int ovector[30];
 	    int options = 0;
 
 	    if (use_UTF8) options = PCRE_UTF8;
@@ -401,19 +639,10 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 		    error(_("'split' string %d is invalid in this locale"), itok+1);
 	    }
 
-	    // PCRE docs say this is not needed, but it is on Windows
-	    if (!tables) tables = pcre_maketables();
-	    re_pcre = pcre_compile(split, options,
-				   &errorptr, &erroffset, tables);
-	    if (!re_pcre) {
-		if (errorptr)
-		    warning(_("PCRE pattern compilation error\n\t'%s'\n\tat '%s'\n"),
-			    errorptr, split+erroffset);
-		error(_("invalid split pattern '%s'"), split);
-	    }
-	    re_pe = pcre_study(re_pcre, 0, &errorptr);
-	    if (errorptr)
-		warning(_("PCRE pattern study error\n\t'%s'\n"), errorptr);
+	    RegexPtr re = pcre_cached(split, options, true,
+				      _("invalid split pattern '%s'"));
+	    re_pcre = re->re_pcre;
+	    re_pe = re->re_pe;
 
 	    vmax2 = vmaxget();
 	    for (i = itok; i < len; i += tlen) {
@@ -488,12 +717,9 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 		}
 		vmaxset(vmax2);
 	    }
-	    pcre_free(re_pe);
-	    pcre_free(re_pcre);
 	} else if (!useBytes && use_UTF8) { /* ERE in wchar_t */
 	    regex_t reg;
 	    regmatch_t regmatch[1];
-	    int rc;
 	    int cflags = REG_EXTENDED;
 	    const wchar_t *wbuf, *wbufp, *wsplit;
 
@@ -505,8 +731,9 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 	    */
 
 	    wsplit = wtransChar(STRING_ELT(tok, itok));
-	    if ((rc = tre_regwcomp(&reg, wsplit, cflags)))
-		reg_report(rc, &reg, translateChar(STRING_ELT(tok, itok)));
+	    RegexPtr re = tre_cached(RE_TRE_WIDE, wsplit, cflags,
+				     translateChar(STRING_ELT(tok, itok)));
+	    reg = re->reg;
 
 	    vmax2 = vmaxget();
 	    for (i = itok; i < len; i += tlen) {
@@ -555,11 +782,9 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 				   mkCharWLen(wbufp, int( wcslen(wbufp))));
 		vmaxset(vmax2);
 	    }
-	    tre_regfree(&reg);
 	} else { /* ERE in normal chars -- single byte or MBCS */
 	    regex_t reg;
 	    regmatch_t regmatch[1];
-	    int rc;
 	    int cflags = REG_EXTENDED;
 
 	    /* Careful: need to distinguish empty (rm_eo == 0) from
@@ -576,8 +801,8 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 		if (mbcslocale && !mbcsValid(split))
 		    error(_("'split' string %d is invalid in this locale"), itok+1);
 	    }
-	    if ((rc = tre_regcomp(&reg, split, cflags)))
-		reg_report(rc, &reg, split);
+	    RegexPtr re = tre_cached(RE_TRE_NATIVE, split, cflags, split);
+	    reg = re->reg;
 
 	    vmax2 = vmaxget();
 	    for (i = itok; i < len; i += tlen) {
@@ -635,7 +860,6 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 		    SET_STRING_ELT(t, ntok, markKnown(bufp, STRING_ELT(x, i)));
 		vmaxset(vmax2);
 	    }
-	    tre_regfree(&reg);
 	}
 	vmaxset(vmax);
     }
@@ -644,34 +868,41 @@ SEXP attribute_hidden do_strsplit(/*const*/ CXXR::Expression* call, const CXXR::
 	namesgets(ans, getAttrib(x, R_NamesSymbol));
     UNPROTECT(1);
     Free(pt); Free(wpt);
-    if (tables) pcre_free(CXXRNOCAST(void *)CXXRCCAST(unsigned char*, tables));
     return ans;
 }
 
+/* The number of UTF-8 characters in the first n bytes of s */
+static int utf8_nchars(const char *s, int n)
+{
+    int nc = 0;
+    for (int i = 0; i < n; i++)
+	if ((s[i] & 0xC0) != 0x80) nc++;
+    return nc;
+}
+
+/* A match of valid UTF-8 in valid UTF-8 always starts on a character,
+   so in UTF-8 (as in bytes or a single-byte locale) the bytes can be
+   searched directly.  Other multibyte encodings may have a match
+   starting inside a character, so are searched a character at a
+   time. */
+static bool fgrep_by_chars(Rboolean useBytes, Rboolean use_UTF8)
+{
+    return !useBytes && !use_UTF8 && mbcslocale && !utf8locale;
+}
+
 /* Used by grep[l] and [g]regexpr, with return value the match
    position in characters */
-/* This could be faster for plen > 1, but uses in R are for small strings */
 static int fgrep_one(const char *pat, const char *target,
 		     Rboolean useBytes, Rboolean use_UTF8, int *next)
 {
     int plen = int( strlen(pat)), len = int( strlen(target));
     int i = -1;
-    const char *p;
 
     if (plen == 0) {
 	if (next != nullptr) *next = 1;
 	return 0;
     }
-    if (plen == 1 && (useBytes || !(mbcslocale || use_UTF8))) {
-	/* a single byte is a common case */
-	for (i = 0, p = target; *p; p++, i++)
-	    if (*p == pat[0]) {
-		if (next != nullptr) *next = i + 1;
-		return i;
-	    }
-	return -1;
-    }
-    if (!useBytes && mbcslocale) { /* skip along by chars */
+    if (fgrep_by_chars(useBytes, use_UTF8)) { /* skip along by chars */
 	mbstate_t mb_st;
 	int ib, used;
 	mbs_init(&mb_st);
@@ -684,24 +915,14 @@ static int fgrep_one(const char *pat, const char *target,
 	    if (used <= 0) break;
 	    ib += used;
 	}
-    } else if (!useBytes && use_UTF8) {
-	int ib, used;
-	for (ib = 0, i = 0; ib <= len-plen; i++) {
-	    if (strncmp(pat, target+ib, plen) == 0) {
-		if (next != nullptr) *next = ib + plen;
-		return i;
-	    }
-	    used = utf8clen(target[ib]);
-	    if (used <= 0) break;
-	    ib += used;
-	}
-    } else
-	for (i = 0; i <= len-plen; i++)
-	    if (strncmp(pat, target+i, plen) == 0) {
-		if (next != nullptr) *next = i + plen;
-		return i;
-	    }
-    return -1;
+	return -1;
+    }
+    const char *p = find_bytes(target, len, pat, plen);
+    if (!p) return -1;
+    int ib = int(p - target);
+    if (next != nullptr) *next = ib + plen;
+    return (!useBytes && (use_UTF8 || mbcslocale))
+	? utf8_nchars(target, ib) : ib;
 }
 
 /* Returns the match position in bytes, for use in [g]sub.
@@ -712,16 +933,9 @@ static int fgrep_one_bytes(const char *pat, const char *target, int len,
 			   Rboolean useBytes, Rboolean use_UTF8)
 {
     int i = -1, plen = int( strlen(pat));
-    const char *p;
 
     if (plen == 0) return 0;
-    if (plen == 1 && (useBytes || !(mbcslocale || use_UTF8))) {
-	/* a single byte is a common case */
-	for (i = 0, p = target; *p; p++, i++)
-	    if (*p == pat[0]) return i;
-	return -1;
-    }
-    if (!useBytes && mbcslocale) { /* skip along by chars */
+    if (fgrep_by_chars(useBytes, use_UTF8)) { /* skip along by chars */
 	mbstate_t mb_st;
 	int ib, used;
 	mbs_init(&mb_st);
@@ -731,18 +945,52 @@ static int fgrep_one_bytes(const char *pat, const char *target, int len,
 	    if (used <= 0) break;
 	    ib += used;
 	}
-    } else if (!useBytes && use_UTF8) { /* not really needed */
-	int ib, used;
-	for (ib = 0, i = 0; ib <= len-plen; i++) {
-	    if (strncmp(pat, target+ib, plen) == 0) return ib;
-	    used = utf8clen(target[ib]);
-	    if (used <= 0) break;
-	    ib += used;
-	}
-    } else
-	for (i = 0; i <= len-plen; i++)
-	    if (strncmp(pat, target+i, plen) == 0) return i;
-    return -1;
+	return -1;
+    }
+    const char *p = find_bytes(target, len, pat, plen);
+    return p ? int(p - target) : -1;
+}
+
+/* A regular expression which is just a string, perhaps anchored by a
+   leading '^' and/or a trailing '$', is matched as a fixed string
+   rather than compiled.  Any character which is special in either ERE
+   or PCRE syntax makes a pattern not literal. */
+enum { LITERAL = 1, LITERAL_START = 2, LITERAL_END = 4 };
+
+static int literalPattern(const char *pat)
+{
+    size_t len = strlen(pat);
+    int kind = LITERAL;
+    if (len && pat[0] == '^') {
+	kind |= LITERAL_START;
+	pat++; len--;
+    }
+    if (len && pat[len - 1] == '$') {
+	kind |= LITERAL_END;
+	len--;
+    }
+    for (size_t i = 0; i < len; i++)
+	if (strchr("\\^$.[]|()?*+{}", pat[i])) return 0;
+    return kind;
+}
+
+/* Does s match the anchored literal lit of length llen?  PCRE's '$'
+   also matches before a final newline, as dollar_nl says. */
+static bool anchored_match(const char *lit, size_t llen, const char *s,
+			   int kind, bool dollar_nl)
+{
+    size_t slen = strlen(s);
+    if (!(kind & LITERAL_END))
+	return slen >= llen && memcmp(s, lit, llen) == 0;
+    int nl = dollar_nl && slen && s[slen - 1] == '\n';
+    for (size_t end = slen - nl; end <= slen; end++) {
+	if (end < llen) continue;
+	if ((kind & LITERAL_START)
+	    ? end == llen && memcmp(s, lit, llen) == 0
+	    : memcmp(s + end - llen, lit, llen) == 0)
+	    return true;
+    }
+    return false;
 }
 
 SEXP attribute_hidden do_grep(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
@@ -750,12 +998,11 @@ SEXP attribute_hidden do_grep(/*const*/ CXXR::Expression* call, const CXXR::Buil
     SEXP pat, text, ind, ans;
     regex_t reg;
     R_xlen_t i, j, n;
-    int nmatches = 0, ov[3], rc;
+    int nmatches = 0;
     int igcase_opt, value_opt, perl_opt, fixed_opt, useBytes, invert;
     const char *spat = nullptr;
     pcre *re_pcre = nullptr /* -Wall */;
     pcre_extra *re_pe = nullptr;
-    const unsigned char *tables = nullptr /* -Wall */;
     Rboolean use_UTF8 = FALSE, use_WC =  FALSE;
     const void *vmax;
     int nwarn = 0;
@@ -842,6 +1089,20 @@ SEXP attribute_hidden do_grep(/*const*/ CXXR::Expression* call, const CXXR::Buil
 		}
     }
 
+    /* A pattern which is just a string needs no regex engine: but not
+       in a non-UTF-8 MBCS, where a byte match need not be a
+       character match. */
+    int literal = 0;
+    bool dollar_nl = false;
+    if (!fixed_opt && !igcase_opt
+	&& (useBytes || use_UTF8 || utf8locale || !mbcslocale))
+	literal = literalPattern(CHAR(STRING_ELT(pat, 0)));
+    if (literal) {
+	dollar_nl = perl_opt;
+	fixed_opt = 1;
+	perl_opt = 0;
+    }
+
     if (!fixed_opt && !perl_opt) {
 	/* if we have non-ASCII text in a DBCS locale, we need to use wchar */
 	if (!useBytes && mbcslocale && !utf8locale) use_UTF8 =TRUE;
@@ -858,89 +1119,113 @@ SEXP attribute_hidden do_grep(/*const*/ CXXR::Expression* call, const CXXR::Buil
 	if (mbcslocale && !mbcsValid(spat))
 	    error(_("regular expression is invalid in this locale"));
     }
+    /* The anchors are ASCII, so still at the ends after translation */
+    std::string lit;
+    if (literal & (LITERAL_START | LITERAL_END)) {
+	size_t start = (literal & LITERAL_START) ? 1 : 0,
+	    end = (literal & LITERAL_END) ? 1 : 0;
+	lit.assign(spat + start, strlen(spat) - start - end);
+    }
 
+    RegexPtr re;
     if (fixed_opt) ; 
     else if (perl_opt) {
-	int cflags = 0, erroffset;
-	const char *errorptr;
+	int cflags = 0;
 	if (igcase_opt) cflags |= PCRE_CASELESS;
 	if (!useBytes && use_UTF8) cflags |= PCRE_UTF8;
-	// PCRE docs say this is not needed, but it is on Windows
-	tables = pcre_maketables();
-	re_pcre = pcre_compile(spat, cflags, &errorptr, &erroffset, tables);
-	if (!re_pcre) {
-	    if (errorptr)
-		warning(_("PCRE pattern compilation error\n\t'%s'\n\tat '%s'\n"),
-			errorptr, spat+erroffset);
-	    error(_("invalid regular expression '%s'"), spat);
-	    if (n > 10) {
-		re_pe = pcre_study(re_pcre, 0, &errorptr);
-		if (errorptr)
-		    warning(_("PCRE pattern study error\n\t'%s'\n"), errorptr);
-	    }
-	}
+	re = pcre_cached(spat, cflags, n > 10,
+			 _("invalid regular expression '%s'"));
+	re_pcre = re->re_pcre;
+	re_pe = re->re_pe;
     } else {
 	int cflags = REG_NOSUB | REG_EXTENDED;
 	if (igcase_opt) cflags |= REG_ICASE;
 	if (!use_WC)
-	    rc = tre_regcompb(&reg, spat, cflags);
+	    re = tre_cached(RE_TRE_BYTES, spat, cflags, spat);
 	else
-	    rc = tre_regwcomp(&reg, wtransChar(STRING_ELT(pat, 0)), cflags);
-	if (rc) reg_report(rc, &reg, spat);
+	    re = tre_cached(RE_TRE_WIDE, wtransChar(STRING_ELT(pat, 0)),
+			    cflags, spat);
+	reg = re->reg;
     }
 
     PROTECT(ind = allocVector(LGLSXP, n));
-    vmax = vmaxget();
-    for (i = 0 ; i < n ; i++) {
-//	if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-	LOGICAL(ind)[i] = 0;
-	if (STRING_ELT(text, i) != NA_STRING) {
-	    const char *s = nullptr;
-	    if (useBytes)
-		s = CHAR(STRING_ELT(text, i));
-	    else if (use_WC) ;
-	    else if (use_UTF8) {
-		s = translateCharUTF8(STRING_ELT(text, i));
-		if (!utf8Valid(s)) {
-		    if(nwarn++ < NWARN)
-			warning(_("input string %d is invalid UTF-8"), i+1);
-		    continue;
-		}
-	    } else {
-		s = translateChar(STRING_ELT(text, i));
-		if (mbcslocale && !mbcsValid(s)) {
-		    if(nwarn++ < NWARN)
-			warning(_("input string %d is invalid in this locale"), i+1);
-		    continue;
-		}
+    int *lind = LOGICAL(ind);
+
+    /* Sets the string to be matched for element i, returning false
+       (after a warning if it is invalid) if there is none.  This may
+       allocate, so is only used on the main thread. */
+    auto subject = [&](R_xlen_t i, const char **s, const wchar_t **ws) {
+	*s = nullptr;
+	*ws = nullptr;
+	if (STRING_ELT(text, i) == NA_STRING)
+	    return false;
+	if (useBytes)
+	    *s = CHAR(STRING_ELT(text, i));
+	else if (use_WC)
+	    *ws = wtransChar(STRING_ELT(text, i));
+	else if (use_UTF8) {
+	    *s = translateCharUTF8(STRING_ELT(text, i));
+	    if (!utf8Valid(*s)) {
+		if(nwarn++ < NWARN)
+		    warning(_("input string %d is invalid UTF-8"), i+1);
+		return false;
 	    }
-
-	    if (fixed_opt)
-		LOGICAL(ind)[i] = fgrep_one(spat, s, CXXRCONSTRUCT(Rboolean, useBytes), use_UTF8, nullptr) >= 0;
-	    else if (perl_opt) {
-		if (pcre_exec(re_pcre, re_pe, s, int( strlen(s)), 0, 0, ov, 0) >= 0)
-		    INTEGER(ind)[i] = 1;
-	    } else {
-		if (!use_WC)
-		    rc = tre_regexecb(&reg, s, 0, nullptr, 0);
-		else
-		    rc = tre_regwexec(&reg, wtransChar(STRING_ELT(text, i)),
-				      0, nullptr, 0);
-		if (rc == 0) LOGICAL(ind)[i] = 1;
+	} else {
+	    *s = translateChar(STRING_ELT(text, i));
+	    if (mbcslocale && !mbcsValid(*s)) {
+		if(nwarn++ < NWARN)
+		    warning(_("input string %d is invalid in this locale"), i+1);
+		return false;
 	    }
 	}
+	return true;
+    };
+    /* Does a string match?  Safe to use on several threads. */
+    auto matches = [&](const char *s, const wchar_t *ws) {
+	int ov[3];
+	if (literal & (LITERAL_START | LITERAL_END))
+	    return anchored_match(lit.c_str(), lit.size(), s, literal,
+				  dollar_nl);
+	else if (fixed_opt)
+	    return fgrep_one(spat, s, CXXRCONSTRUCT(Rboolean, useBytes), use_UTF8, nullptr) >= 0;
+	else if (perl_opt)
+	    return pcre_exec(re_pcre, re_pe, s, int( strlen(s)), 0, 0, ov, 0) >= 0;
+	else if (!use_WC)
+	    return tre_regexecb(&reg, s, 0, nullptr, 0) == 0;
+	else
+	    return tre_regwexec(&reg, ws, 0, nullptr, 0) == 0;
+    };
+
+    vmax = vmaxget();
+    int nthreads = regexThreads(n);
+    if (nthreads > 1) {
+	/* Find all the strings first, then match them on several
+	   threads. */
+	std::vector<const char *> ss(n);
+	std::vector<const wchar_t *> wss(use_WC ? n : 0);
+	std::vector<char> ok(n);
+	const wchar_t *unused;
+	for (i = 0 ; i < n ; i++)
+	    ok[i] = subject(i, &ss[i], use_WC ? &wss[i] : &unused);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 256)
+#endif
+	for (R_xlen_t k = 0 ; k < n ; k++)
+	    lind[k] = ok[k] && matches(ss[k], use_WC ? wss[k] : nullptr);
 	vmaxset(vmax);
-	if (invert ^ LOGICAL(ind)[i]) nmatches++;
+	for (i = 0 ; i < n ; i++)
+	    if (invert ^ lind[i]) nmatches++;
+    } else {
+	for (i = 0 ; i < n ; i++) {
+//	    if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
+	    const char *s;
+	    const wchar_t *ws;
+	    lind[i] = subject(i, &s, &ws) && matches(s, ws);
+	    vmaxset(vmax);
+	    if (invert ^ lind[i]) nmatches++;
+	}
     }
 
-    if (fixed_opt);
-    else if (perl_opt) {
-	if (re_pe) pcre_free(re_pe);
-	pcre_free(re_pcre);
-	pcre_free(CXXRNOCAST(void *)CXXRCCAST(unsigned char*, tables));
-    } else
-	tre_regfree(&reg);
-
     if (op->variant()) {/* grepl case */
 	UNPROTECT(1);
 	return ind;
@@ -1490,13 +1775,144 @@ static int wcount_subs(const wchar_t *repl)
  * either once or globally.
  * The functions are loosely patterned on the "sub" and "gsub" in "nawk". */
 
+/* Grows buf, in which u points, to hold at least nns chars. */
+static char *sub_reserve(std::vector<char>& buf, char *u, int nns)
+{
+    size_t used = u - buf.data();
+    if (buf.size() < size_t(nns)) buf.resize(nns);
+    return buf.data() + used;
+}
+
+/* Replaces the first (or, if global, every) match of a PCRE pattern in
+   s by srep, writing the result to buf.  Returns the number of matches,
+   so 0 if s is unchanged, or -1 if the result would be too long.  This
+   neither allocates R objects nor signals errors, so may be used on
+   several threads unless case changes are needed in a UTF-8 string
+   (see pcre_string_adj). */
+static int pcre_sub_one(const char *s, pcre *re_pcre, pcre_extra *re_pe,
+			const char *srep, size_t replen, int global,
+			Rboolean use_UTF8, std::vector<char>& buf)
+{
+    int ncap, maxrep, ovector[30], eflag, ns, nns, offset, nmatch,
+	last_end, j;
+    char *u;
+    memset(ovector, 0, 30*sizeof(int)); /* zero for unknown patterns */
+    ns = int( strlen(s));
+    /* worst possible scenario is to put a copy of the
+       replacement after every character, unless there are
+       backrefs */
+    maxrep = int(replen + (ns-2) * count_subs(srep));
+    if (global) {
+	/* Integer overflow has been seen */
+	double dnns = ns * (maxrep + 1.) + 1000;
+	if (dnns > 10000) dnns = double(2*ns + replen + 1000);
+	nns = int( dnns);
+    } else nns = ns + maxrep + 1000;
+    u = sub_reserve(buf, buf.data(), nns);
+    offset = 0; nmatch = 0; eflag = 0; last_end = -1;
+    /* ncap is one more than the number of capturing patterns */
+    while ((ncap = pcre_exec(re_pcre, re_pe, s, ns, offset, eflag,
+			     ovector, 30)) >= 0) {
+	nmatch++;
+	for (j = offset; j < ovector[0]; j++) *u++ = s[j];
+	if (ovector[1] > last_end) {
+	    u = pcre_string_adj(u, s, srep, ovector, use_UTF8);
+	    last_end = ovector[1];
+	}
+	offset = ovector[1];
+	if (s[offset] == '\0' || !global) break;
+	if (ovector[1] == ovector[0]) {
+	    /* advance by a char */
+	    if (use_UTF8) {
+		int used, pos = 0;
+		while( (used = utf8clen(s[pos])) ) {
+		    pos += used;
+		    if (pos > offset) {
+			for (j = offset; j < pos; j++) *u++ = s[j];
+			offset = pos;
+			break;
+		    }
+		}
+	    } else
+		*u++ = s[offset++];
+	}
+	if (nns < (u - buf.data()) + (ns-offset) + maxrep + 100) {
+	    if (nns > INT_MAX/2) return -1;
+	    nns *= 2;
+	    u = sub_reserve(buf, u, nns);
+	}
+	eflag = PCRE_NOTBOL;  /* probably not needed */
+    }
+    if (nmatch == 0) return 0;
+    /* copy the tail */
+    if (nns < (u - buf.data()) + (ns-offset)+1) {
+	if (nns > INT_MAX/2) return -1;
+	nns *= 2;
+	u = sub_reserve(buf, u, nns);
+    }
+    for (j = offset ; s[j] ; j++) *u++ = s[j];
+    *u = '\0';
+    return nmatch;
+}
+
+/* As pcre_sub_one, for an extended regexp in bytes. */
+static int tre_sub_one(const char *s, const regex_t *reg, const char *srep,
+		       size_t replen, int global, std::vector<char>& buf)
+{
+    int maxrep, ns, nns, offset, nmatch, eflags, last_end, j;
+    regmatch_t regmatch[10];
+    char *u;
+
+    ns = int( strlen(s));
+    /* worst possible scenario is to put a copy of the
+       replacement after every character, unless there are
+       backrefs */
+    maxrep = int(replen + (ns-2) * count_subs(srep));
+    if (global) {
+	double dnns = ns * (maxrep + 1.) + 1000;
+	if (dnns > 10000) dnns = double(2*ns + replen + 1000);
+	nns = int( dnns);
+    } else nns = ns + maxrep + 1000;
+    u = sub_reserve(buf, buf.data(), nns);
+    offset = 0; nmatch = 0; eflags = 0; last_end = -1;
+    while (tre_regexecb(reg, s+offset, 10, regmatch, eflags) == 0) {
+	nmatch++;
+	for (j = 0; j < regmatch[0].rm_so ; j++)
+	    *u++ = s[offset+j];
+	if (offset+regmatch[0].rm_eo > last_end) {
+	    u = string_adj(u, s+offset, srep, regmatch);
+	    last_end = offset+regmatch[0].rm_eo;
+	}
+	offset += regmatch[0].rm_eo;
+	if (s[offset] == '\0' || !global) break;
+	if (regmatch[0].rm_eo == regmatch[0].rm_so)
+	    *u++ = s[offset++];
+	if (nns < (u - buf.data()) + (ns-offset) + maxrep + 100) {
+	    if (nns > INT_MAX/2) return -1;
+	    nns *= 2;
+	    u = sub_reserve(buf, u, nns);
+	}
+	eflags = REG_NOTBOL;
+    }
+    if (nmatch == 0) return 0;
+    /* copy the tail */
+    if (nns < (u - buf.data()) + (ns-offset)+1) {
+	if (nns > INT_MAX/2) return -1;
+	nns *= 2;
+	u = sub_reserve(buf, u, nns);
+    }
+    for (j = offset ; s[j] ; j++) *u++ = s[j];
+    *u = '\0';
+    return nmatch;
+}
+
 SEXP attribute_hidden do_gsub(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
 {
     SEXP pat, rep, text, ans;
     regex_t reg;
     regmatch_t regmatch[10];
     R_xlen_t i, n;
-    int j, ns, nns, nmatch, offset, rc;
+    int j, ns, nns, nmatch, offset;
     int global, igcase_opt, perl_opt, fixed_opt, useBytes, eflags, last_end;
     char *u, *cbuf;
     const char *spat = nullptr, *srep = nullptr, *s = nullptr;
@@ -1505,7 +1921,7 @@ SEXP attribute_hidden do_gsub(/*const*/ CXXR::Expression* call, const CXXR::Buil
     const wchar_t *wrep = nullptr;
     pcre *re_pcre = nullptr;
     pcre_extra *re_pe  = nullptr;
-    const unsigned char *tables = nullptr;
+    RegexPtr re;
     const void *vmax = vmaxget();
 
     op->checkNumArgs(num_args, call);
@@ -1575,6 +1991,17 @@ SEXP attribute_hidden do_gsub(/*const*/ CXXR::Expression* call, const CXXR::Buil
 	    useBytes = TRUE;
 	}
     }
+    /* A pattern which is just a string, with a replacement containing
+       no backreferences, can be substituted as a fixed string.  Only
+       for bytes, where both paths mark the results the same way. */
+    if (useBytes && !fixed_opt && !igcase_opt
+	&& literalPattern(CHAR(STRING_ELT(pat, 0))) == LITERAL
+	&& CHAR(STRING_ELT(pat, 0))[0]
+	&& (STRING_ELT(rep, 0) == NA_STRING
+	    || !strchr(CHAR(STRING_ELT(rep, 0)), '\\'))) {
+	fixed_opt = 1;
+	perl_opt = 0;
+    }
     if (!useBytes) {
 	if (!fixed_opt && mbcslocale) use_UTF8 = TRUE;
 	else if (IS_UTF8(STRING_ELT(pat, 0))) use_UTF8 = TRUE;
@@ -1615,50 +2042,35 @@ SEXP attribute_hidden do_gsub(/*const*/ CXXR::Expression* call, const CXXR::Buil
 	if (!patlen) error(_("zero-length pattern"));
 	replen = strlen(srep);
     } else if (perl_opt) {
-	int cflags = 0, erroffset;
-	const char *errorptr;
+	int cflags = 0;
 	if (use_UTF8) cflags |= PCRE_UTF8;
 	if (igcase_opt) cflags |= PCRE_CASELESS;
-	// PCRE docs say this is not needed, but it is on Windows
-	tables = pcre_maketables();
-	re_pcre = pcre_compile(spat, cflags, &errorptr, &erroffset, tables);
-	if (!re_pcre) {
-	    if (errorptr)
-		warning(_("PCRE pattern compilation error\n\t'%s'\n\tat '%s'\n"),
-			errorptr, spat+erroffset);
-	    error(_("invalid regular expression '%s'"), spat);
-	}
-	if (n > 10) {
-	    re_pe = pcre_study(re_pcre, 0, &errorptr);
-	    if (errorptr)
-		warning(_("PCRE pattern study error\n\t'%s'\n"), errorptr);
-	}
+	re = pcre_cached(spat, cflags, n > 10,
+			 _("invalid regular expression '%s'"));
+	re_pcre = re->re_pcre;
+	re_pe = re->re_pe;
 	replen = strlen(srep);
     } else {
 	int cflags = REG_EXTENDED;
 	if (igcase_opt) cflags |= REG_ICASE;
 	if (!use_WC) {
-	    rc =  tre_regcompb(&reg, spat, cflags);
-	    if (rc) reg_report(rc, &reg, spat);
+	    re = tre_cached(RE_TRE_BYTES, spat, cflags, spat);
 	    replen = strlen(srep);
 	} else {
-	    rc  = tre_regwcomp(&reg, wtransChar(STRING_ELT(pat, 0)), cflags);
-	    if (rc) reg_report(rc, &reg, CHAR(STRING_ELT(pat, 0)));
+	    re = tre_cached(RE_TRE_WIDE, wtransChar(STRING_ELT(pat, 0)),
+			    cflags, CHAR(STRING_ELT(pat, 0)));
 	    wrep = wtransChar(STRING_ELT(rep, 0));
 	    replen = wcslen(wrep);
 	}
+	reg = re->reg;
     }
 
     PROTECT(ans = allocVector(STRSXP, n));
-    vmax = vmaxget();
-    for (i = 0 ; i < n ; i++) {
-//	if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
-	/* NA pattern was handled above */
-	if (STRING_ELT(text, i) == NA_STRING) {
-	    SET_STRING_ELT(ans, i, NA_STRING);
-	    continue;
-	}
 
+    /* The string in which to substitute for (non-NA) element i.  This
+       may allocate, so is only used on the main thread. */
+    auto subject = [&](R_xlen_t i) {
+	const char *s = nullptr;
 	if (useBytes)
 	    s = CHAR(STRING_ELT(text, i));
 	else if (use_WC) ;
@@ -1670,6 +2082,68 @@ SEXP attribute_hidden do_gsub(/*const*/ CXXR::Expression* call, const CXXR::Buil
 	    if (mbcslocale && !mbcsValid(s))
 		error(("input string %d is invalid in this locale"), i+1);
 	}
+	return s;
+    };
+    /* Stores the result of pcre_sub_one or tre_sub_one for element i. */
+    auto setResult = [&](R_xlen_t i, int nmatch, const std::vector<char>& buf) {
+	if (nmatch < 0) error(_("result string is too long"));
+	if (nmatch == 0)
+	    SET_STRING_ELT(ans, i, STRING_ELT(text, i));
+	else if (STRING_ELT(rep, 0) == NA_STRING)
+	    SET_STRING_ELT(ans, i, NA_STRING);
+	else if (useBytes)
+	    SET_STRING_ELT(ans, i, mkChar(buf.data()));
+	else if (use_UTF8)
+	    SET_STRING_ELT(ans, i, mkCharCE(buf.data(), CE_UTF8));
+	else
+	    SET_STRING_ELT(ans, i, markKnown(buf.data(), STRING_ELT(text, i)));
+    };
+    std::vector<char> sbuf;
+
+    vmax = vmaxget();
+    i = 0;
+    int nthreads = regexThreads(n);
+    if (nthreads > 1 && !fixed_opt && (perl_opt || !use_WC)
+	&& !(perl_opt && use_UTF8
+	     && (strstr(srep, "\\U") || strstr(srep, "\\L")))) {
+	/* Substitute in blocks of strings on several threads, making
+	   the CHARSXPs for each block here. */
+	const R_xlen_t block = 16384;
+	std::vector<const char *> ss(block);
+	std::vector<int> nm(block);
+	std::vector<std::vector<char> > bufs(block);
+	for (R_xlen_t start = 0; start < n; start += block) {
+	    R_xlen_t len = std::min(block, n - start);
+	    for (R_xlen_t k = 0; k < len; k++)
+		ss[k] = (STRING_ELT(text, start + k) == NA_STRING)
+		    ? nullptr : subject(start + k);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 64)
+#endif
+	    for (R_xlen_t k = 0; k < len; k++)
+		if (ss[k])
+		    nm[k] = perl_opt
+			? pcre_sub_one(ss[k], re_pcre, re_pe, srep, replen,
+				       global, use_UTF8, bufs[k])
+			: tre_sub_one(ss[k], &reg, srep, replen, global,
+				      bufs[k]);
+	    for (R_xlen_t k = 0; k < len; k++) {
+		if (ss[k]) setResult(start + k, nm[k], bufs[k]);
+		else SET_STRING_ELT(ans, start + k, NA_STRING);
+	    }
+	    vmaxset(vmax);
+	}
+	i = n;
+    }
+    for ( ; i < n ; i++) {
+//	if ((i+1) % NINTERRUPT == 0) R_CheckUserInterrupt();
+	/* NA pattern was handled above */
+	if (STRING_ELT(text, i) == NA_STRING) {
+	    SET_STRING_ELT(ans, i, NA_STRING);
+	    continue;
+	}
+
+	s = subject(i);
 
 	if (fixed_opt) {
 	    int st, nr, slen = int( strlen(s));
@@ -1710,146 +2184,12 @@ SEXP attribute_hidden do_gsub(/*const*/ CXXR::Expression* call, const CXXR::Buil
 		    SET_STRING_ELT(ans, i, markKnown(cbuf, STRING_ELT(text, i)));
 		Free(cbuf);
 	    }
-	} else if (perl_opt) {
-	   int ncap, maxrep, ovector[30], eflag;
-	   memset(ovector, 0, 30*sizeof(int)); /* zero for unknown patterns */
-	   ns = int( strlen(s));
-	   /* worst possible scenario is to put a copy of the
-	      replacement after every character, unless there are
-	      backrefs */
-	   maxrep = int(replen + (ns-2) * count_subs(srep));
-	   if (global) {
-	       /* Integer overflow has been seen */
-	       double dnns = ns * (maxrep + 1.) + 1000;
-	       if (dnns > 10000) dnns = double(2*ns + replen + 1000);
-	       nns = int( dnns);
-	   } else nns = ns + maxrep + 1000;
-	   u = cbuf = Calloc(nns, char);
-	   offset = 0; nmatch = 0; eflag = 0; last_end = -1;
-	   /* ncap is one more than the number of capturing patterns */
-	   while ((ncap = pcre_exec(re_pcre, re_pe, s, ns, offset, eflag,
-				   ovector, 30)) >= 0) {
-	       /* printf("%s, %d, %d %d\n", s, offset,
-		  ovector[0], ovector[1]); */
-	       nmatch++;
-	       for (j = offset; j < ovector[0]; j++) *u++ = s[j];
-	       if (ovector[1] > last_end) {
-		   u = pcre_string_adj(u, s, srep, ovector, use_UTF8);
-		   last_end = ovector[1];
-	       }
-	       offset = ovector[1];
-	       if (s[offset] == '\0' || !global) break;
-	       if (ovector[1] == ovector[0]) {
-		   /* advance by a char */
-		   if (use_UTF8) {
-		       int used, pos = 0;
-		       while( (used = utf8clen(s[pos])) ) {
-			   pos += used;
-			   if (pos > offset) {
-			       for (j = offset; j < pos; j++) *u++ = s[j];
-			       offset = pos;
-			       break;
-			   }
-		       }
-		   } else
-		       *u++ = s[offset++];
-	       }
-	       if (nns < (u - cbuf) + (ns-offset) + maxrep + 100) {
-		   char *tmp;
-		   if (nns > INT_MAX/2) error(_("result string is too long"));
-		   nns *= 2;
-		   tmp = Realloc(cbuf, nns, char);
-		   u = tmp + (u - cbuf);
-		   cbuf = tmp;
-	       }
-	       eflag = PCRE_NOTBOL;  /* probably not needed */
-	   }
-	   if (nmatch == 0)
-	       SET_STRING_ELT(ans, i, STRING_ELT(text, i));
-	   else if (STRING_ELT(rep, 0) == NA_STRING)
-	       SET_STRING_ELT(ans, i, NA_STRING);
-	   else {
-	       /* copy the tail */
-	       if (nns < (u - cbuf) + (ns-offset)+1) {
-		   char *tmp;
-		   if (nns > INT_MAX/2) error(_("result string is too long"));
-		   nns *= 2;
-		   tmp = Realloc(cbuf, nns, char);
-		   u = tmp + (u - cbuf);
-		   cbuf = tmp;
-	       }
-	       for (j = offset ; s[j] ; j++) *u++ = s[j];
-	       *u = '\0';
-	       if (useBytes)
-		   SET_STRING_ELT(ans, i, mkChar(cbuf));
-	       else if (use_UTF8)
-		   SET_STRING_ELT(ans, i, mkCharCE(cbuf, CE_UTF8));
-	       else
-		   SET_STRING_ELT(ans, i, markKnown(cbuf, STRING_ELT(text, i)));
-	   }	
-	   Free(cbuf);
-       } else if (!use_WC) {
-	    int maxrep;
-	    /* extended regexp in bytes */
-
-	    ns = int( strlen(s));
-	    /* worst possible scenario is to put a copy of the
-	       replacement after every character, unless there are
-	       backrefs */
-	    maxrep = int(replen + (ns-2) * count_subs(srep));
-	    if (global) {
-		double dnns = ns * (maxrep + 1.) + 1000;
-		if (dnns > 10000) dnns = double(2*ns + replen + 1000);
-		nns = int( dnns);
-	    } else nns = ns + maxrep + 1000;
-	    u = cbuf = Calloc(nns, char);
-	    offset = 0; nmatch = 0; eflags = 0; last_end = -1;
-	    while (tre_regexecb(&reg, s+offset, 10, regmatch, eflags) == 0) {
-		/* printf("%s, %d %d\n", &s[offset],
-		   regmatch[0].rm_so, regmatch[0].rm_eo); */
-		nmatch++;
-		for (j = 0; j < regmatch[0].rm_so ; j++)
-		    *u++ = s[offset+j];
-		if (offset+regmatch[0].rm_eo > last_end) {
-		    u = string_adj(u, s+offset, srep, regmatch);
-		    last_end = offset+regmatch[0].rm_eo;
-		}
-		offset += regmatch[0].rm_eo;
-		if (s[offset] == '\0' || !global) break;
-		if (regmatch[0].rm_eo == regmatch[0].rm_so)
-		    *u++ = s[offset++];
-		if (nns < (u - cbuf) + (ns-offset) + maxrep + 100) {
-		    char *tmp;
-		    if (nns > INT_MAX/2) error(_("result string is too long"));
-		    nns *= 2;
-		    tmp = Realloc(cbuf, nns, char);
-		    u = tmp + (u - cbuf);
-		    cbuf = tmp;
-		}
-		eflags = REG_NOTBOL;
-	    }
-	    if (nmatch == 0)
-		SET_STRING_ELT(ans, i, STRING_ELT(text, i));
-	    else if (STRING_ELT(rep, 0) == NA_STRING)
-		SET_STRING_ELT(ans, i, NA_STRING);
-	    else {
-		/* copy the tail */
-		if (nns < (u - cbuf) + (ns-offset)+1) {
-		    char *tmp;
-		    if (nns > INT_MAX/2) error(_("result string is too long"));
-		    nns *= 2;
-		    tmp = Realloc(cbuf, nns, char);
-		    u = tmp + (u - cbuf);
-		    cbuf = tmp;
-		}
-		for (j = offset ; s[j] ; j++) *u++ = s[j];
-		*u = '\0';
-		if (useBytes)
-		    SET_STRING_ELT(ans, i, mkChar(cbuf));
-		else
-		    SET_STRING_ELT(ans, i, markKnown(cbuf, STRING_ELT(text, i)));
-	    }
-	    Free(cbuf);
+	} else if (perl_opt || !use_WC) {
+	    int nmatch = perl_opt
+		? pcre_sub_one(s, re_pcre, re_pe, srep, replen, global,
+			       use_UTF8, sbuf)
+		: tre_sub_one(s, &reg, srep, replen, global, sbuf);
+	    setResult(i, nmatch, sbuf);
 	} else  {
 	    /* extended regexp in wchar_t */
 	    const wchar_t *s = wtransChar(STRING_ELT(text, i));
@@ -1914,12 +2254,6 @@ SEXP attribute_hidden do_gsub(/*const*/ CXXR::Expression* call, const CXXR::Buil
 	vmaxset(vmax);
     }
 
-    if (fixed_opt) ; 
-    else if (perl_opt) {
-	if (re_pe) pcre_free(re_pe);
-	pcre_free(re_pcre);
-	pcre_free(CXXRNOCAST(void *)CXXRCCAST(unsigned char*, tables));
-    } else tre_regfree(&reg);
     DUPLICATE_ATTRIB(ans, text);
     /* This copied the class, if any */
     UNPROTECT(1);
@@ -2319,7 +2653,6 @@ SEXP attribute_hidden do_regexpr(/*const*/ CXXR::Expression* call, const CXXR::B
     const char *s = nullptr;
     pcre *re_pcre = nullptr /* -Wall */;
     pcre_extra *re_pe = nullptr;
-    const unsigned char *tables = nullptr /* -Wall */;
     Rboolean use_UTF8 = FALSE, use_WC = FALSE;
     const void *vmax;
     int capture_count, *ovector = nullptr, ovector_size = 0, /* -Wall */
@@ -2380,6 +2713,13 @@ SEXP attribute_hidden do_regexpr(/*const*/ CXXR::Expression* call, const CXXR::B
 	    useBytes = TRUE;
 	}
     }
+    /* As for sub, a plain string pattern is matched as one */
+    if (useBytes && !fixed_opt && !igcase_opt
+	&& literalPattern(CHAR(STRING_ELT(pat, 0))) == LITERAL
+	&& CHAR(STRING_ELT(pat, 0))[0]) {
+	fixed_opt = 1;
+	perl_opt = 0;
+    }
     if (!useBytes && !use_UTF8) {
 	/* As from R 2.10.0 we use UTF-8 mode in PCRE in all MBCS locales,
 	   and as from 2.11.0 in TRE too. */
@@ -2411,26 +2751,16 @@ SEXP attribute_hidden do_regexpr(/*const*/ CXXR::Expression* call, const CXXR::B
 	    error(_("regular expression is invalid in this locale"));
     }
 
+    RegexPtr re;
     if (fixed_opt) ; 
     else if (perl_opt) {
-	int cflags = 0, erroffset;
-	const char *errorptr;
+	int cflags = 0;
 	if (igcase_opt) cflags |= PCRE_CASELESS;
 	if (!useBytes && use_UTF8) cflags |= PCRE_UTF8;
-	// PCRE docs say this is not needed, but it is on Windows
-	tables = pcre_maketables();
-	re_pcre = pcre_compile(spat, cflags, &errorptr, &erroffset, tables);
-	if (!re_pcre) {
-	    if (errorptr)
-		warning(_("PCRE pattern compilation error\n\t'%s'\n\tat '%s'\n"),
-			errorptr, spat+erroffset);
-	    error(_("invalid regular expression '%s'"), spat);
-	}
-	if (n > 10) {
-	    re_pe = pcre_study(re_pcre, 0, &errorptr);
-	    if (errorptr)
-		warning(_("PCRE pattern study error\n\t'%s'\n"), errorptr);
-	}
+	re = pcre_cached(spat, cflags, n > 10,
+			 _("invalid regular expression '%s'"));
+	re_pcre = re->re_pcre;
+	re_pe = re->re_pe;
 	/* also extract info for named groups */
 	pcre_fullinfo(re_pcre, re_pe, PCRE_INFO_NAMECOUNT, &name_count);
 	pcre_fullinfo(re_pcre, re_pe, PCRE_INFO_NAMEENTRYSIZE, &name_entry_size);
@@ -2455,10 +2785,11 @@ SEXP attribute_hidden do_regexpr(/*const*/ CXXR::Expression* call, const CXXR::B
 	int cflags = REG_EXTENDED;
 	if (igcase_opt) cflags |= REG_ICASE;
 	if (!use_WC)
-	    rc = tre_regcompb(&reg, spat, cflags);
+	    re = tre_cached(RE_TRE_BYTES, spat, cflags, spat);
 	else
-	    rc = tre_regwcomp(&reg, wtransChar(STRING_ELT(pat, 0)), cflags);
-	if (rc) reg_report(rc, &reg, spat);
+	    re = tre_cached(RE_TRE_WIDE, wtransChar(STRING_ELT(pat, 0)),
+			    cflags, spat);
+	reg = re->reg;
     }
 
     if (op->variant() == 0) { /* regexpr */
@@ -2609,15 +2940,10 @@ SEXP attribute_hidden do_regexpr(/*const*/ CXXR::Expression* call, const CXXR::B
 	}
     }
 
-    if (fixed_opt) ; 
-    else if (perl_opt) {
-	if (re_pe) pcre_free(re_pe);
-	pcre_free(re_pcre);
-	pcre_free(CXXRNOCAST(void *)CXXRCCAST(unsigned char*, tables));
+    if (perl_opt && !fixed_opt) {
 	UNPROTECT(1);
 	free(ovector);
-    } else
-	tre_regfree(&reg);
+    }
 
     UNPROTECT(1);
     return ans;
@@ -30,8 +30,13 @@
 #include <Defn.h>
 #include <Internal.h>
 
+#include <vector>
+
+#include "CXXR/ArgList.hpp"
 #include "CXXR/RAllocStack.h"
 
+using namespace CXXR;
+
 SEXP attribute_hidden
 do_mapply(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* rho, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
 {
@@ -99,8 +104,22 @@ do_mapply(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXX
 	    SET_TAG(fcall, installTrChar(STRING_ELT(vnames, j)));
     }
 
+    /* 'MoreArgs' follows the m varying arguments in the call. */
+    SEXP moreArgs = fcall;
+    for (int j = 0; j < m; j++)
+	moreArgs = CDR(moreArgs);
+
     REPROTECT(fcall = LCONS(f, fcall), fi);
 
+    /* When f is a closure, call it directly rather than by eval(),
+       passing elements of the varying arguments that are not objects
+       as promises already forced to their values: see do_lapply. */
+    const Closure* closure
+	= (TYPEOF(f) == CLOSXP) ? SEXP_downcast<const Closure*>(f) : nullptr;
+    std::vector<SEXP> cells;
+    for (SEXP a = CDR(fcall); a != moreArgs; a = CDR(a))
+	cells.push_back(a);
+
     SEXP ans = PROTECT(allocVector(VECSXP, longest));
 
     for (int i = 0; i < longest; i++) {
@@ -111,7 +130,25 @@ do_mapply(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXX
 	    else
 		INTEGER(VECTOR_ELT(nindex, j))[0] = int( counters[j]);
 	}
-	SEXP tmp = eval(fcall, rho);
+	SEXP tmp;
+	if (closure) {
+	    ArgList more(SEXP_downcast<PairList*>(moreArgs), ArgList::RAW);
+	    more.wrapInPromises(rho);
+	    GCStackRoot<PairList> promargs(const_cast<PairList*>(more.list()));
+	    for (int j = m - 1; j >= 0; j--) {
+		SEXP cell = cells[j], dj = VECTOR_ELT(varyingArgs, j);
+		Expression* expr = SEXP_downcast<Expression*>(CAR(cell));
+		GCStackRoot<> value(OBJECT(dj) ? nullptr
+				    : R_vectorElement(dj, counters[j] - 1));
+		SEXP prom = value ? Promise::createEvaluatedPromise(expr, value)
+		    : new Promise(expr, rho);
+		promargs = SEXP_downcast<PairList*>(CONS(prom, promargs));
+		SET_TAG(promargs, TAG(cell));
+	    }
+	    tmp = R_invokeClosure(closure, SEXP_downcast<Expression*>(fcall),
+				  promargs, rho);
+	} else
+	    tmp = eval(fcall, rho);
 	if (MAYBE_REFERENCED(tmp))
 	    tmp = duplicate(tmp);
 	SET_VECTOR_ELT(ans, i, tmp);
@@ -424,6 +424,13 @@ void R_gc(void)
     GCManager::gc();
 }
 
+/* Called in a forked child to keep the pages it shares with its
+   parent shared: see GCNode::freezeHeap(). */
+void R_FreezeHeap(void)
+{
+    GCNode::freezeHeap();
+}
+
 
 #define R_MAX(a,b) (a) < (b) ? (b) : (a)
 
@@ -41,6 +41,7 @@
 
 #include "Print.h"
 #include "RBufferUtils.h"
+#include <string>
 #include <vector>
 
 using namespace std;
@@ -63,9 +64,9 @@ SEXP attribute_hidden do_paste(/*const*/ CXXR::Expression* call, const CXXR::Bui
 {
     SEXP ans, collapse, sep, x;
     int sepw, u_sepw;
-    R_xlen_t i, j, k, maxlen, nx, pwidth;
+    R_xlen_t i, j, maxlen, nx, pwidth;
     cetype_t ienc;
-    const char *s, *cbuf, *csep=nullptr, *u_csep=nullptr;
+    const char *s, *csep=nullptr, *u_csep=nullptr;
     char *buf;
     bool allKnown, anyKnown, use_UTF8, use_Bytes,
 	sepASCII = TRUE, sepUTF8 = FALSE, sepBytes = FALSE, sepKnown = FALSE,
@@ -136,6 +137,19 @@ SEXP attribute_hidden do_paste(/*const*/ CXXR::Expression* call, const CXXR::Bui
 
     PROTECT(ans = allocVector(STRSXP, maxlen));
 
+    /* Each row is built in one pass: its parts are found (translating
+       only non-ASCII strings, once each) and measured, then copied
+       into a buffer of exactly the right size. */
+    std::vector<SEXP> xs(nx);
+    std::vector<R_xlen_t> ks(nx);
+    for (j = 0; j < nx; j++) {
+	xs[j] = VECTOR_ELT(x, j);
+	ks[j] = xlength(xs[j]);
+    }
+    std::vector<const char *> parts(nx);
+    std::vector<size_t> widths(nx);
+    std::string row;
+
     for (i = 0; i < maxlen; i++) {
 	/* Strategy for marking the encoding: if all inputs (including
 	 * the separator) are ASCII, so is the output and we don't
@@ -143,35 +157,44 @@ SEXP attribute_hidden do_paste(/*const*/ CXXR::Expression* call, const CXXR::Bui
 	 * declared encoding, we should mark.
 	 * Need to be careful only to include separator if it is used.
 	 */
+	bool allASCII = TRUE;
 	anyKnown = FALSE; allKnown = TRUE; use_UTF8 = FALSE; use_Bytes = FALSE;
 	if(nx > 1) {
 	    allKnown = sepKnown || sepASCII;
 	    anyKnown = sepKnown;
 	    use_UTF8 = sepUTF8;
 	    use_Bytes = sepBytes;
+	    allASCII = sepASCII;
 	}
 
-	pwidth = 0;
 	for (j = 0; j < nx; j++) {
-	    k = xlength(VECTOR_ELT(x, j));
-	    if (k > 0) {
-		SEXP cs = STRING_ELT(VECTOR_ELT(x, j), i % k);
+	    if (ks[j] > 0) {
+		SEXP cs = STRING_ELT(xs[j], i % ks[j]);
 		if(IS_UTF8(cs)) use_UTF8 = TRUE;
 		if(IS_BYTES(cs)) use_Bytes = TRUE;
+		if(!IS_ASCII(cs)) allASCII = FALSE;
 	    }
 	}
 	if (use_Bytes) use_UTF8 = FALSE;
 	vmax = vmaxget();
+	pwidth = 0;
 	for (j = 0; j < nx; j++) {
-	    k = xlength(VECTOR_ELT(x, j));
-	    if (k > 0) {
-		if(use_Bytes)
-		    pwidth += strlen(CHAR(STRING_ELT(VECTOR_ELT(x, j), i % k)));
-		else if(use_UTF8)
-		    pwidth += strlen(translateCharUTF8(STRING_ELT(VECTOR_ELT(x, j), i % k)));
-		else
-		    pwidth += strlen(translateChar(STRING_ELT(VECTOR_ELT(x, j), i % k)));
-		vmaxset(vmax);
+	    if (ks[j] > 0) {
+		SEXP cs = STRING_ELT(xs[j], i % ks[j]);
+		if (use_Bytes || IS_ASCII(cs)) {
+		    s = CHAR(cs);
+		    widths[j] = LENGTH(cs);
+		} else {
+		    s = use_UTF8 ? translateCharUTF8(cs) : translateChar(cs);
+		    widths[j] = strlen(s);
+		}
+		parts[j] = s;
+		pwidth += widths[j];
+		if (!use_UTF8) {
+		    allKnown = allKnown && (IS_ASCII(cs) || strIsASCII(s)
+					    || (ENC_KNOWN(cs) > 0));
+		    anyKnown = anyKnown || (ENC_KNOWN(cs) > 0);
+		}
 	    }
 	}
 	if(use_sep) {
@@ -183,35 +206,24 @@ SEXP attribute_hidden do_paste(/*const*/ CXXR::Expression* call, const CXXR::Bui
 	}
 	if (pwidth > INT_MAX)
 	    error(_("result would exceed 2^31-1 bytes"));
-	cbuf = buf = static_cast<char*>(R_AllocStringBuffer(pwidth, &cbuff));
-	vmax = vmaxget();
+	row.resize(pwidth);
+	buf = &row[0];
 	for (j = 0; j < nx; j++) {
-	    k = xlength(VECTOR_ELT(x, j));
-	    if (k > 0) {
-		SEXP cs = STRING_ELT(VECTOR_ELT(x, j), i % k);
-		if (use_UTF8) {
-		    s = translateCharUTF8(cs);
-		    strcpy(buf, s);
-		    buf += strlen(s);
-		} else {
-		    s = use_Bytes ? CHAR(cs) : translateChar(cs);
-		    strcpy(buf, s);
-		    buf += strlen(s);
-		    allKnown = allKnown && (strIsASCII(s) || (ENC_KNOWN(cs)> 0));
-		    anyKnown = anyKnown || (ENC_KNOWN(cs)> 0);
-		}
+	    if (ks[j] > 0) {
+		memcpy(buf, parts[j], widths[j]);
+		buf += widths[j];
 	    }
 	    if (sepw != 0 && j != nx - 1) {
 		if (use_UTF8) {
-		    strcpy(buf, u_csep);
+		    memcpy(buf, u_csep, u_sepw);
 		    buf += u_sepw;
 		} else {
-		    strcpy(buf, csep);
+		    memcpy(buf, csep, sepw);
 		    buf += sepw;
 		}
 	    }
-	    vmax = vmaxget();
 	}
+	vmaxset(vmax);
 	ienc = CE_NATIVE;
 	if(use_UTF8) ienc = CE_UTF8;
 	else if(use_Bytes) ienc = CE_BYTES;
@@ -219,7 +231,7 @@ SEXP attribute_hidden do_paste(/*const*/ CXXR::Expression* call, const CXXR::Bui
 	    if(known_to_be_latin1) ienc = CE_LATIN1;
 	    if(known_to_be_utf8) ienc = CE_UTF8;
 	}
-	SET_STRING_ELT(ans, i, mkCharCE(cbuf, ienc));
+	SET_STRING_ELT(ans, i, CXXR::String::obtain(row, ienc, allASCII));
     }
 
     /* Now collapse, if required. */
@@ -242,36 +254,40 @@ SEXP attribute_hidden do_paste(/*const*/ CXXR::Expression* call, const CXXR::Bui
 	sepw = int( strlen(csep));
 	anyKnown = ENC_KNOWN(sep) > 0;
 	allKnown = anyKnown || strIsASCII(csep);
-	pwidth = 0;
+	/* As above, but the pieces are already translated unless
+	   going to UTF-8. */
+	parts.resize(nx);
+	widths.resize(nx);
 	vmax = vmaxget();
-	for (i = 0; i < nx; i++)
-	    if(use_UTF8) {
-		pwidth += strlen(translateCharUTF8(STRING_ELT(ans, i)));
-		vmaxset(vmax);
-	    } else /* already translated */
-		pwidth += strlen(CHAR(STRING_ELT(ans, i)));
+	pwidth = 0;
+	for (i = 0; i < nx; i++) {
+	    SEXP cs = STRING_ELT(ans, i);
+	    if (use_UTF8 && !IS_ASCII(cs)) {
+		parts[i] = translateCharUTF8(cs);
+		widths[i] = strlen(parts[i]);
+	    } else {
+		parts[i] = CHAR(cs);
+		widths[i] = LENGTH(cs);
+	    }
+	    pwidth += widths[i];
+	    allKnown = allKnown &&
+		(IS_ASCII(cs) || strIsASCII(parts[i]) || (ENC_KNOWN(cs) > 0));
+	    anyKnown = anyKnown || (ENC_KNOWN(cs) > 0);
+	}
 	pwidth += (nx - 1) * sepw;
 	if (pwidth > INT_MAX)
 	    error(_("result would exceed 2^31-1 bytes"));
-	cbuf = buf = static_cast<char*>(R_AllocStringBuffer(pwidth, &cbuff));
-	vmax = vmaxget();
+	row.resize(pwidth);
+	buf = &row[0];
 	for (i = 0; i < nx; i++) {
 	    if(i > 0) {
-		strcpy(buf, csep);
+		memcpy(buf, csep, sepw);
 		buf += sepw;
 	    }
-	    if(use_UTF8)
-		s = translateCharUTF8(STRING_ELT(ans, i));
-	    else /* already translated */
-		s = CHAR(STRING_ELT(ans, i));
-	    strcpy(buf, s);
-	    while (*buf)
-		buf++;
-	    allKnown = allKnown &&
-		(strIsASCII(s) || (ENC_KNOWN(STRING_ELT(ans, i)) > 0));
-	    anyKnown = anyKnown || (ENC_KNOWN(STRING_ELT(ans, i)) > 0);
-	    if(use_UTF8) vmaxset(vmax);
+	    memcpy(buf, parts[i], widths[i]);
+	    buf += widths[i];
 	}
+	vmaxset(vmax);
 	UNPROTECT(1);
 	ienc = CE_NATIVE;
 	if(use_UTF8) ienc = CE_UTF8;
@@ -281,9 +297,8 @@ SEXP attribute_hidden do_paste(/*const*/ CXXR::Expression* call, const CXXR::Bui
 	    if(known_to_be_utf8) ienc = CE_UTF8;
 	}
 	PROTECT(ans = allocVector(STRSXP, 1));
-	SET_STRING_ELT(ans, 0, mkCharCE(cbuf, ienc));
+	SET_STRING_ELT(ans, 0, CXXR::String::obtain(row, ienc));
     }
-    R_FreeStringBufferL(&cbuff);
     UNPROTECT(1);
     return ans;
 }
@@ -1775,6 +1775,8 @@ SEXP attribute_hidden do_setlocale(/*const*/ CXXR::Expression* call, const CXXR:
 	cat = LC_ALL;
 	/* assume we can set LC_CTYPE iff we can set the rest */
 	if ((p = setlocale(LC_CTYPE, l))) {
+	    R_ClearRegexCache();
+	    String::localeChanged();
 	    setlocale(LC_COLLATE, l);
 	    resetICUcollator();
 	    setlocale(LC_MONETARY, l);
@@ -1792,6 +1794,8 @@ SEXP attribute_hidden do_setlocale(/*const*/ CXXR::Expression* call, const CXXR:
     case 3:
 	cat = LC_CTYPE;
 	p = setlocale(cat, CHAR(STRING_ELT(locale, 0)));
+	R_ClearRegexCache();
+	String::localeChanged();
 	break;
     case 4:
 	cat = LC_MONETARY;
@@ -49,6 +49,8 @@
 #include <Fileio.h>
 #include <Rconnections.h>
 #include <errno.h>
+#include <algorithm>
+#include <vector>
 #include "CXXR/GCStackRoot.hpp"
 #include "CXXR/ProvenanceTracker.h"
 
@@ -225,12 +227,12 @@ strtoraw (const char *nptr, char **endptr)
 static R_INLINE int scanchar_raw(LocalData *d)
 {
     int c = (d->ttyflag) ? ConsoleGetcharWithPushBack(d->con) :
-	Rconn_fgetc(d->con);
+	Rconn_fgetc_buffered(d->con);
     if(c == 0) {
 	if(d->skipNul) {
 	    do {
 		c = (d->ttyflag) ? ConsoleGetcharWithPushBack(d->con) :
-		    Rconn_fgetc(d->con);
+		    Rconn_fgetc_buffered(d->con);
 	    } while(c == 0);
 	} else d->embedWarn = TRUE;
     }
@@ -994,6 +996,447 @@ SEXP attribute_hidden do_scan(/*const*/ CXXR::Expression* call, const CXXR::Buil
     return ans;
 }
 
+/* ------------- Multithreaded reader for delimited files -------------
+
+   readDelim() is the backend read.table() uses for the common case of
+   a plain file with a one-byte separator and none of the options that
+   need scan()'s character-at-a-time processing.  It gives the same
+   result as the scan() call in read.table() followed by the
+   type.convert() calls that would turn columns into logical, integer
+   or numeric vectors: anything it is not sure about is left as a
+   character column for type.convert() to handle as before.
+
+   The file is read into memory in one go.  A pass driven by memchr()
+   finds the quoted strings and splits the data at line boundaries
+   into one chunk per thread.  The chunks are split into fields in
+   parallel, each field being unquoted and nul-terminated in place.
+   The fields are then dealt into rows by the same rules as
+   scanFrame(), and the columns are typed and converted in parallel.
+   Only the final creation of CHARSXPs is done serially. */
+
+namespace {
+    struct DelimField {
+	size_t start;  // offset of the nul-terminated field in the buffer
+	size_t len;
+    };
+
+    struct DelimChunk {
+	size_t begin, end;
+	std::vector<DelimField> fields;
+	std::vector<int> linefields;  // number of fields on each line
+	bool eofline;  // last line is terminated by EOF, not '\n'
+    };
+
+    enum DelimType {DELIM_LGL, DELIM_INT, DELIM_REAL, DELIM_STR};
+}
+
+/* Split buf[begin, end) into up to nchunks pieces, each starting at a
+   line start outside any quoted string.  Returns false if the data
+   end inside a quoted string. */
+static bool delimChunks(const char *buf, size_t begin, size_t end,
+			const char *quoteset, int nchunks,
+			std::vector<size_t>& bounds)
+{
+    size_t nq = strlen(quoteset), p = begin;
+    std::vector<size_t> nextq(nq, 0);
+    bool searched = false;
+    int k = 1;
+    size_t target = begin + (end - begin)/nchunks;
+
+    bounds.assign(1, begin);
+    for (;;) {
+	/* Outside quotes at p: find the next quote of any kind. */
+	size_t qpos = end;
+	char q = 0;
+	for (size_t i = 0; i < nq; i++) {
+	    if (!searched || (nextq[i] < p && nextq[i] != end)) {
+		const char *s = static_cast<const char*>(
+		    memchr(buf + p, quoteset[i], end - p));
+		nextq[i] = s ? size_t(s - buf) : end;
+	    }
+	    if (nextq[i] < qpos) {
+		qpos = nextq[i];
+		q = quoteset[i];
+	    }
+	}
+	searched = true;
+	/* Chunk boundaries can only fall before qpos. */
+	while (k < nchunks) {
+	    size_t from = std::max(std::max(p, target), bounds.back());
+	    if (from >= qpos) break;
+	    const char *nl = static_cast<const char*>(
+		memchr(buf + from, '\n', qpos - from));
+	    if (!nl) break;
+	    bounds.push_back(size_t(nl - buf) + 1);
+	    k++;
+	    target = begin + k * ((end - begin)/nchunks);
+	}
+	if (qpos == end) break;
+	const char *close = static_cast<const char*>(
+	    memchr(buf + qpos + 1, q, end - qpos - 1));
+	if (!close) return false;
+	p = size_t(close - buf) + 1;
+    }
+    bounds.push_back(end);
+    return true;
+}
+
+/* Split a chunk into fields as fillBuffer() does for character fields
+   with a separator, stopping once maxlines lines with content have
+   been seen if maxlines > 0.  Safe to call on any thread. */
+static void delimTokenize(char *buf, DelimChunk& chunk, char sep,
+			  const bool *isquote, size_t maxlines)
+{
+    size_t p = chunk.begin, end = chunk.end, nonblank = 0;
+    chunk.eofline = false;
+    while (p < end && (maxlines == 0 || nonblank < maxlines)) {
+	int nf = 0;
+	int term;
+	do {
+	    size_t start = p, out = p;
+	    char c;
+	    while (p < end && (c = buf[p]) != sep && c != '\n') {
+		if (isquote[static_cast<unsigned char>(c)]) {
+		    /* CSV style: a doubled quote stands for itself */
+		    p++;
+		    for (;;) {
+			while (p < end && buf[p] != c) buf[out++] = buf[p++];
+			if (p < end) p++;
+			if (p < end && buf[p] == c) buf[out++] = buf[p++];
+			else break;
+		    }
+		} else buf[out++] = buf[p++];
+	    }
+	    term = (p < end) ? buf[p] : R_EOF;
+	    buf[out] = '\0';
+	    chunk.fields.push_back({start, out - start});
+	    nf++;
+	    if (p < end) p++;
+	} while (term == sep);
+	if (nf > 1 || chunk.fields.back().len > 0) nonblank++;
+	chunk.linefields.push_back(nf);
+	if (term == R_EOF) chunk.eofline = true;
+    }
+}
+
+/* Is s empty or all ASCII white space?  Sets *ascii to false if s has
+   a non-ASCII byte, as that might be white space in the locale. */
+static R_INLINE bool delimBlank(const char *s, bool *ascii)
+{
+    for (; *s; s++) {
+	if (static_cast<unsigned char>(*s) >= 0x80) {
+	    *ascii = false;
+	    return false;
+	}
+	if (!isspace(static_cast<unsigned char>(*s))) return false;
+    }
+    return true;
+}
+
+static R_INLINE bool delimNA(const char *s,
+			     const std::vector<const char*>& nastrings)
+{
+    for (const char *na : nastrings)
+	if (!strcmp(s, na)) return true;
+    return false;
+}
+
+/* The type type.convert() would give column x, except that DELIM_STR
+   is returned whenever the answer needs more than a logical, integer
+   or double conversion.  Safe to call on any thread. */
+static DelimType delimColumnType(const std::vector<const char*>& x,
+				 const std::vector<const char*>& nastrings,
+				 char dec, bool allowreal)
+{
+    bool lgl = true, isint = true, real = allowreal;
+    for (const char *s : x) {
+	bool ascii = true;
+	if (delimNA(s, nastrings) || delimBlank(s, &ascii))
+	    continue;
+	if (!ascii) return DELIM_STR;
+	if (lgl)
+	    lgl = !strcmp(s, "F") || !strcmp(s, "T")
+		|| !strcmp(s, "FALSE") || !strcmp(s, "TRUE");
+	if (isint)
+	    isint = (Strtoi(s, 10) != NA_INTEGER);
+	if (real && !isint) {
+	    char *endp;
+	    R_strtod4(s, &endp, dec, FALSE);
+	    real = delimBlank(endp, &ascii);
+	}
+	if (!lgl && !isint && !real) return DELIM_STR;
+    }
+    return lgl ? DELIM_LGL : (isint ? DELIM_INT : DELIM_REAL);
+}
+
+/* Skip a logical line as readtablehead() reads it. */
+static size_t delimSkipHeader(const char *buf, size_t p, size_t end,
+			      int sep, const bool *isquote)
+{
+    int quote = 0;
+    bool firstnonwhite = true;
+    while (p < end) {
+	int c = static_cast<unsigned char>(buf[p++]);
+	if (quote) {
+	    if (c == quote) {
+		if (p < end && buf[p] == quote) p++;
+		else quote = 0;
+	    }
+	} else if (firstnonwhite && isquote[c]) quote = c;
+	else if (Rspace(c) || c == sep) firstnonwhite = true;
+	else firstnonwhite = false;
+	if (!quote && c == '\n') break;
+    }
+    return p;
+}
+
+/* readDelim(file, sep, quote, dec, skip, header, nrows, cols, fill,
+	     blank.lines.skip, na.strings, convert, numerals, encoding)
+
+   Returns NULL if the file cannot be read this way, and read.table()
+   then falls back to scan(). */
+SEXP attribute_hidden do_readdelim(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* rho, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
+{
+    op->checkNumArgs(num_args, call);
+    SEXP sfile = args[0], ssep = args[1], squote = args[2], sdec = args[3];
+    int nskip = asInteger(args[4]), header = asLogical(args[5]);
+    int nmax = asInteger(args[6]), nc = asInteger(args[7]);
+    int fill = asLogical(args[8]), blskip = asLogical(args[9]);
+    SEXP nastrings = args[10], convert = args[11];
+    SEXP numerals = args[12], sencoding = args[13];
+
+    if (!isString(sfile) || LENGTH(sfile) != 1
+	|| STRING_ELT(sfile, 0) == NA_STRING)
+	error(_("invalid '%s' argument"), "file");
+    if (!isString(ssep) || LENGTH(ssep) != 1
+	|| strlen(translateChar(STRING_ELT(ssep, 0))) != 1)
+	error(_("invalid 'sep' value: must be one byte"));
+    if (!isString(sdec) || LENGTH(sdec) != 1
+	|| strlen(translateChar(STRING_ELT(sdec, 0))) != 1)
+	error(_("invalid decimal separator: must be one byte"));
+    if (!(isString(squote) || isNull(squote)))
+	error(_("invalid quote symbol set"));
+    if (TYPEOF(nastrings) != STRSXP)
+	error(_("invalid '%s' argument"), "na.strings");
+    if (nc == NA_INTEGER || nc <= 0 || TYPEOF(convert) != LGLSXP
+	|| LENGTH(convert) != nc)
+	error(_("invalid '%s' argument"), "cols");
+    if (!isString(numerals) || !isString(sencoding))
+	error(_("invalid '%s' argument"), "numerals");
+    if (nskip < 0 || nskip == NA_INTEGER) nskip = 0;
+    if (nmax < 0 || nmax == NA_INTEGER) nmax = 0;
+    if (blskip == NA_LOGICAL) blskip = 1;
+    if (fill == NA_LOGICAL) fill = 0;
+
+    int sep = static_cast<unsigned char>(translateChar(STRING_ELT(ssep, 0))[0]);
+    char dec = translateChar(STRING_ELT(sdec, 0))[0];
+    bool isquote[256] = {false};
+    const char *quoteset = "";
+    if (isString(squote) && LENGTH(squote) > 0)
+	quoteset = translateChar(STRING_ELT(squote, 0));
+    for (const char *q = quoteset; *q; q++)
+	isquote[static_cast<unsigned char>(*q)] = true;
+    /* In a DBCS the trail bytes can look like any of these. */
+    if ((mbcslocale && !utf8locale) || sep >= 0x80 || sep == '\n'
+	|| isquote[sep] || static_cast<unsigned char>(dec) >= 0x80)
+	return R_NilValue;
+    for (const char *q = quoteset; *q; q++)
+	if (static_cast<unsigned char>(*q) >= 0x80) return R_NilValue;
+    bool allowreal = streql(CHAR(STRING_ELT(numerals, 0)), "allow.loss");
+    const char *encoding = CHAR(STRING_ELT(sencoding, 0));
+    cetype_t enc = streql(encoding, "UTF-8") ? CE_UTF8
+	: (streql(encoding, "latin1") ? CE_LATIN1 : CE_NATIVE);
+    std::vector<const char*> nas(LENGTH(nastrings));
+    for (int i = 0; i < LENGTH(nastrings); i++)
+	nas[i] = CHAR(STRING_ELT(nastrings, i));
+
+    /* Read the whole file, leaving a byte for a final terminator. */
+    std::vector<char> buf;
+    {
+	const char *path = R_ExpandFileName(translateChar(STRING_ELT(sfile, 0)));
+	FILE *fp = R_fopen(path, "rb");
+	if (!fp) return R_NilValue;
+	size_t n = 0, res;
+	buf.resize(1 << 20);
+	while ((res = fread(buf.data() + n, 1, buf.size() - 1 - n, fp)) > 0) {
+	    n += res;
+	    if (n == buf.size() - 1) buf.resize(2 * buf.size());
+	}
+	bool failed = ferror(fp);
+	fclose(fp);
+	if (failed) return R_NilValue;
+	buf.resize(n + 1);
+    }
+    size_t n = buf.size() - 1;
+    char *b = buf.data();
+    /* file() would decompress these, and scan() would stop at a nul */
+    if ((n >= 2 && !memcmp(b, "\x1f\x8b", 2))
+	|| (n >= 3 && !memcmp(b, "BZh", 3))
+	|| (n >= 5 && !memcmp(b, "\xFD" "7zXZ", 5))
+	|| memchr(b, '\0', n))
+	return R_NilValue;
+    /* With fill = FALSE an incomplete final row is an error or a
+       warning depending on whether the line was read by
+       readtablehead(): leave that to scan(). */
+    if (!fill && n > 0 && b[n - 1] != '\n' && b[n - 1] != '\r')
+	return R_NilValue;
+
+    /* Map CR and CRLF to LF, as Rconn_fgetc() does. */
+    if (memchr(b, '\r', n)) {
+	size_t out = 0;
+	for (size_t p = 0; p < n; p++) {
+	    if (b[p] == '\r') {
+		b[out++] = '\n';
+		if (p + 1 < n && b[p + 1] == '\n') p++;
+	    } else b[out++] = b[p];
+	}
+	n = out;
+    }
+
+    /* Find the start of the data. */
+    size_t begin = 0;
+    for (int i = 0; i < nskip && begin < n; i++) {
+	const char *nl = static_cast<const char*>(memchr(b + begin, '\n', n - begin));
+	begin = nl ? size_t(nl - b) + 1 : n;
+    }
+    if (header == TRUE) {
+	if (blskip)
+	    while (begin < n && b[begin] == '\n') begin++;
+	begin = delimSkipHeader(b, begin, n, sep, isquote);
+    }
+    /* fillBuffer() removes a BOM from the first field it reads. */
+    if (utf8locale && n - begin >= 3 && !memcmp(b + begin, "\xef\xbb\xbf", 3))
+	begin += 3;
+
+    int nthreads = 1;
+#ifdef _OPENMP
+    if (R_num_math_threads > 1 && nmax == 0 && n - begin > (1 << 20))
+	nthreads = R_num_math_threads;
+#endif
+    std::vector<size_t> bounds;
+    if (!delimChunks(b, begin, n, quoteset, nthreads, bounds))
+	return R_NilValue; // scan() will warn about the EOF in a string
+    int nchunks = int(bounds.size()) - 1;
+    std::vector<DelimChunk> chunks(nchunks);
+    for (int k = 0; k < nchunks; k++) {
+	chunks[k].begin = bounds[k];
+	chunks[k].end = bounds[k + 1];
+    }
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+#endif
+    for (int k = 0; k < nchunks; k++)
+	delimTokenize(b, chunks[k], char(sep), isquote, size_t(nmax));
+
+    /* Deal the fields into rows, as scanFrame() does. */
+    std::vector<std::vector<const char*> > cols(nc);
+    static const char empty[] = "";
+    int colsread = 0, linesread = 0;
+    R_xlen_t nrow = 0;
+    bool done = false;
+    for (int k = 0; k < nchunks && !done; k++) {
+	const DelimChunk& chunk = chunks[k];
+	size_t f = 0, nlines = chunk.linefields.size();
+	for (size_t l = 0; l < nlines && !done; l++) {
+	    int nf = chunk.linefields[l];
+	    bool eof = chunk.eofline && l == nlines - 1;
+	    for (int j = 0; j < nf; j++, f++) {
+		const DelimField& field = chunk.fields[f];
+		if (colsread == 0 && field.len == 0 && j == nf - 1
+		    && (eof || blskip))
+		    continue;
+		cols[colsread].push_back(b + field.start);
+		if (++colsread == nc) {
+		    nrow++;
+		    colsread = 0;
+		}
+	    }
+	    if (eof) break;
+	    if (++linesread % 1000 == 999) R_CheckUserInterrupt();
+	    if (colsread != 0) {
+		if (!fill)
+		    error(_("line %d did not have %d elements"), linesread, nc);
+		for (; colsread < nc; colsread++)
+		    cols[colsread].push_back(empty);
+		nrow++;
+		colsread = 0;
+	    }
+	    if (nmax > 0 && nrow >= nmax) done = true;
+	}
+    }
+    if (colsread != 0) {
+	for (; colsread < nc; colsread++)
+	    cols[colsread].push_back(empty);
+	nrow++;
+    }
+
+    /* Type the columns which read.table() would pass to type.convert(). */
+    std::vector<DelimType> types(nc, DELIM_STR);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (int j = 0; j < nc; j++)
+	if (LOGICAL(convert)[j] == TRUE)
+	    types[j] = delimColumnType(cols[j], nas, dec, allowreal);
+
+    SEXP ans;
+    std::vector<void*> data(nc);
+    PROTECT(ans = allocVector(VECSXP, nc));
+    for (int j = 0; j < nc; j++) {
+	SEXPTYPE type = types[j] == DELIM_LGL ? LGLSXP
+	    : (types[j] == DELIM_INT ? INTSXP
+	       : (types[j] == DELIM_REAL ? REALSXP : STRSXP));
+	SEXP col = allocVector(type, nrow);
+	SET_VECTOR_ELT(ans, j, col);
+	if (type == LGLSXP) data[j] = LOGICAL(col);
+	else if (type == INTSXP) data[j] = INTEGER(col);
+	else if (type == REALSXP) data[j] = REAL(col);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (int j = 0; j < nc; j++) {
+	const std::vector<const char*>& x = cols[j];
+	bool ascii;
+	switch (types[j]) {
+	case DELIM_LGL: {
+	    int *lx = static_cast<int*>(data[j]);
+	    for (R_xlen_t i = 0; i < nrow; i++)
+		lx[i] = (delimNA(x[i], nas) || delimBlank(x[i], &ascii))
+		    ? NA_LOGICAL : (x[i][0] == 'T');
+	    break;
+	}
+	case DELIM_INT: {
+	    int *ix = static_cast<int*>(data[j]);
+	    for (R_xlen_t i = 0; i < nrow; i++)
+		ix[i] = (delimNA(x[i], nas) || delimBlank(x[i], &ascii))
+		    ? NA_INTEGER : Strtoi(x[i], 10);
+	    break;
+	}
+	case DELIM_REAL: {
+	    double *rx = static_cast<double*>(data[j]);
+	    for (R_xlen_t i = 0; i < nrow; i++)
+		rx[i] = (delimNA(x[i], nas) || delimBlank(x[i], &ascii))
+		    ? NA_REAL : R_strtod4(x[i], nullptr, dec, FALSE);
+	    break;
+	}
+	case DELIM_STR:
+	    break;
+	}
+    }
+    for (int j = 0; j < nc; j++) {
+	if (types[j] != DELIM_STR) continue;
+	const std::vector<const char*>& x = cols[j];
+	SEXP col = VECTOR_ELT(ans, j);
+	for (R_xlen_t i = 0; i < nrow; i++)
+	    SET_STRING_ELT(col, i, delimNA(x[i], nas) ? NA_STRING
+			   : mkCharCE(x[i], enc));
+    }
+    UNPROTECT(1);
+    ProvenanceTracker::flagXenogenesis();
+    return ans;
+}
+
 SEXP attribute_hidden do_readln(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* rho, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
 {
     int c;
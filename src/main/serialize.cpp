@@ -39,11 +39,20 @@
 #include <Rversion.h>
 #include <R_ext/RS.h>           /* for CallocCharBuf, Free */
 #include <errno.h>
+#include <sys/stat.h>
 
 #include <cstdarg>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "CXXR/ByteCode.hpp"
 #include "CXXR/DottedArgs.hpp"
+#include "CXXR/GCRoot.h"
+#include "CXXR/MappedFile.hpp"
 #include "CXXR/GCStackRoot.hpp"
 #include "CXXR/StdFrame.hpp"
 #include "CXXR/WeakRef.h"
@@ -180,11 +189,14 @@ using namespace CXXR;
  * Forward Declarations
  */
 
-static void OutStringVec(R_outpstream_t stream, SEXP s, SEXP ref_table);
-static void WriteItem (SEXP s, SEXP ref_table, R_outpstream_t stream);
-static SEXP ReadItem(SEXP ref_table, R_inpstream_t stream);
-static void WriteBC(SEXP s, SEXP ref_table, R_outpstream_t stream);
-static SEXP ReadBC(SEXP ref_table, R_inpstream_t stream);
+class WriteRefTable;
+class ReadRefTable;
+
+static void OutStringVec(R_outpstream_t stream, SEXP s, WriteRefTable* ref_table);
+static void WriteItem (SEXP s, WriteRefTable* ref_table, R_outpstream_t stream);
+static SEXP ReadItem(ReadRefTable* ref_table, R_inpstream_t stream);
+static void WriteBC(SEXP s, WriteRefTable* ref_table, R_outpstream_t stream);
+static SEXP ReadBC(ReadRefTable* ref_table, R_inpstream_t stream);
 
 /*
  * Constants
@@ -240,6 +252,7 @@ static void OutInteger(R_outpstream_t stream, int i)
 	stream->OutBytes(stream, buf, int(strlen(buf)));
 	break;
     case R_pstream_binary_format:
+    case R_pstream_mapped_format:
 	stream->OutBytes(stream, &i, sizeof(int));
 	break;
     case R_pstream_xdr_format:
@@ -287,6 +300,7 @@ static void OutReal(R_outpstream_t stream, double d)
 	stream->OutBytes(stream, buf, (int)strlen(buf));
 	break;
     case R_pstream_binary_format:
+    case R_pstream_mapped_format:
 	stream->OutBytes(stream, &d, sizeof(double));
 	break;
     case R_pstream_xdr_format:
@@ -314,6 +328,7 @@ static void OutByte(R_outpstream_t stream, Rbyte i)
 	stream->OutBytes(stream, buf, int(strlen(buf)));
 	break;
     case R_pstream_binary_format:
+    case R_pstream_mapped_format:
     case R_pstream_xdr_format:
 	stream->OutBytes(stream, &i, 1);
 	break;
@@ -400,6 +415,7 @@ static int InInteger(R_inpstream_t stream)
 	    if(sscanf(buf, "%d", &i) != 1) Rf_error(_("read error"));
 	return i;
     case R_pstream_binary_format:
+    case R_pstream_mapped_format:
 	stream->InBytes(stream, &i, sizeof(int));
 	return i;
     case R_pstream_xdr_format:
@@ -443,6 +459,7 @@ static double InReal(R_inpstream_t stream)
 		!= 1) Rf_error(_("read error"));
 	return d;
     case R_pstream_binary_format:
+    case R_pstream_mapped_format:
 	stream->InBytes(stream, &d, sizeof(double));
 	return d;
     case R_pstream_xdr_format:
@@ -544,8 +561,8 @@ static void InString(R_inpstream_t stream, char *buf, int length)
 /*
  * Format Header Reading and Writing
  *
- * The header starts with one of three characters, A for ascii, B for
- * binary, or X for xdr.
+ * The header starts with one of four characters, A for ascii, B for
+ * binary, X for xdr, or M for the mapped format.
  */
 
 static void OutFormat(R_outpstream_t stream)
@@ -560,6 +577,7 @@ static void OutFormat(R_outpstream_t stream)
 	stream->OutBytes(stream, "A\n", 2); break;
     case R_pstream_binary_format: stream->OutBytes(stream, "B\n", 2); break;
     case R_pstream_xdr_format:    stream->OutBytes(stream, "X\n", 2); break;
+    case R_pstream_mapped_format: stream->OutBytes(stream, "M\n", 2); break;
     case R_pstream_any_format:
 	Rf_error(_("must specify ascii, binary, or xdr format"));
     default: Rf_error(_("unknown output format"));
@@ -575,6 +593,7 @@ static void InFormat(R_inpstream_t stream)
     case 'A': type = R_pstream_ascii_format; break;
     case 'B': type = R_pstream_binary_format; break;
     case 'X': type = R_pstream_xdr_format; break;
+    case 'M': type = R_pstream_mapped_format; break;
     case '\n':
 	/* GROSS HACK: ASCII unserialize may leave a trailing newline
 	   in the stream.  If the stream contains a second
@@ -607,53 +626,82 @@ static void InFormat(R_inpstream_t stream)
  *
  * Hashing functions for hashing reference objects during writing.
  * Objects are entered, and the order in which they are encountered is
- * recorded.  GashGet returns this number, a positive integer, if the
- * object was seen before, and zero if not.  A fixed hash table size
- * is used; this is not ideal but seems adequate for now.  The hash
- * table representation consists of a (R_NilValue . vector) pair.  The
- * hash buckets are in the vector.  This indirect representation
- * should allow resizing the table at some point.
+ * recorded.  HashGet returns this number, a positive integer, if the
+ * object was seen before, and zero if not.  The table is an
+ * open-addressed map from object addresses to these numbers, with
+ * linear probing; it doubles in size whenever it becomes half full.
+ * It lives outside the R heap, so entering an object allocates no
+ * GCNodes.  The objects entered are all reachable from the object
+ * being serialized, so the table need not protect them.
  */
 
-#define HASHSIZE 1099
+#define INITIAL_HASH_TABLE_SIZE 1024
 
-#define PTRHASH(obj) ((R_size_t( (obj))) >> 2)
+class WriteRefTable {
+public:
+    WriteRefTable()
+	: m_keys(INITIAL_HASH_TABLE_SIZE, nullptr),
+	  m_values(INITIAL_HASH_TABLE_SIZE), m_count(0)
+    {}
 
-#define HASH_TABLE_COUNT(ht) TRUELENGTH(ht)
-#define SET_HASH_TABLE_COUNT(ht, val) SET_TRUELENGTH(ht, val)
+    void add(const RObject* obj);
 
-#define HASH_TABLE_SIZE(ht) LENGTH(ht)
+    int get(const RObject* obj) const
+    {
+	size_t mask = m_keys.size() - 1;
+	for (size_t pos = hash(obj) & mask; m_keys[pos];
+	     pos = (pos + 1) & mask)
+	    if (m_keys[pos] == obj)
+		return m_values[pos];
+	return 0;
+    }
+private:
+    vector<const RObject*> m_keys;
+    vector<int> m_values;
+    int m_count;
 
-#define HASH_BUCKET(ht, pos) VECTOR_ELT(ht, pos)
-#define SET_HASH_BUCKET(ht, pos, val) SET_VECTOR_ELT(ht, pos, val)
+    // Objects are at least 8-byte aligned, so the low bits carry no
+    // information; the multiplication spreads the rest over the word.
+    static size_t hash(const RObject* obj)
+    {
+	uint64_t h = uint64_t(reinterpret_cast<uintptr_t>(obj) >> 3)
+	    * UINT64_C(0x9E3779B97F4A7C15);
+	return size_t(h >> 32);
+    }
 
-static SEXP MakeHashTable(void)
+    void insert(const RObject* obj, int value)
+    {
+	size_t mask = m_keys.size() - 1;
+	size_t pos = hash(obj) & mask;
+	while (m_keys[pos])
+	    pos = (pos + 1) & mask;
+	m_keys[pos] = obj;
+	m_values[pos] = value;
+    }
+};
+
+void WriteRefTable::add(const RObject* obj)
 {
-    SEXP val = Rf_allocVector(VECSXP, HASHSIZE);
-    SET_HASH_TABLE_COUNT(val, 0);
-    return val;
+    if (2 * size_t(m_count + 1) > m_keys.size()) {
+	vector<const RObject*> keys(2 * m_keys.size(), nullptr);
+	vector<int> values(keys.size());
+	keys.swap(m_keys);
+	values.swap(m_values);
+	for (size_t i = 0; i < keys.size(); i++)
+	    if (keys[i])
+		insert(keys[i], values[i]);
+    }
+    insert(obj, ++m_count);
 }
 
-static void HashAdd(SEXP obj, SEXP ht)
+static R_INLINE void HashAdd(SEXP obj, WriteRefTable* ht)
 {
-    R_size_t pos = PTRHASH(obj) % HASH_TABLE_SIZE(ht);
-    int count = HASH_TABLE_COUNT(ht) + 1;
-    SEXP val = Rf_ScalarInteger(count);
-    SEXP cell = CONS(val, HASH_BUCKET(ht, pos));
-
-    SET_HASH_TABLE_COUNT(ht, count);
-    SET_HASH_BUCKET(ht, pos, cell);
-    SET_TAG(cell, obj);
+    ht->add(obj);
 }
 
-static int HashGet(SEXP item, SEXP ht)
+static R_INLINE int HashGet(SEXP item, WriteRefTable* ht)
 {
-    R_size_t pos = PTRHASH(item) % HASH_TABLE_SIZE(ht);
-    SEXP cell;
-    for (cell = HASH_BUCKET(ht, pos); cell != R_NilValue; cell = CDR(cell))
-	if (item == TAG(cell))
-	    return INTEGER(CAR(cell))[0];
-    return 0;
+    return ht->get(item);
 }
 
 
@@ -835,7 +883,7 @@ static void WriteLENGTH(R_outpstream_t stream, SEXP s)
 #endif
 }
 
-static void OutStringVec(R_outpstream_t stream, SEXP s, SEXP ref_table)
+static void OutStringVec(R_outpstream_t stream, SEXP s, WriteRefTable* ref_table)
 {
     R_assert(TYPEOF(s) == STRSXP);
 
@@ -862,37 +910,202 @@ static void OutStringVec(R_outpstream_t stream, SEXP s, SEXP ref_table)
 
 #define min2(a, b) ((a) < (b)) ? (a) : (b)
 
+/* Vector payloads in the native binary format are passed to OutBytes
+   and InBytes directly from and into the vector's storage, in as few
+   calls as the int length argument allows. */
+#define BULK_CHUNK_BYTES (1 << 30)
+
+/* XDR stores integers and doubles as big-endian 4- and 8-byte words,
+   which is the native representation on big-endian hosts (R assumes
+   IEEE 754 doubles throughout).  On little-endian hosts an XDR payload
+   differs from the native one only in the byte order of each word, so
+   it is converted with the loops below rather than element by element
+   through xdr_int()/xdr_double(); they are written so that the
+   compiler can vectorise them.  src and dest may be the same. */
+
+#ifndef WORDS_BIGENDIAN
+static R_INLINE uint32_t bswap32(uint32_t x)
+{
+    return (x << 24) | ((x & 0xff00) << 8) | ((x >> 8) & 0xff00) | (x >> 24);
+}
+
+static R_INLINE uint64_t bswap64(uint64_t x)
+{
+    return (uint64_t(bswap32(uint32_t(x))) << 32)
+	| bswap32(uint32_t(x >> 32));
+}
+
+static void XDRSwap4(void *dest, const void *src, R_xlen_t n)
+{
+    const char *s = static_cast<const char*>(src);
+    char *d = static_cast<char*>(dest);
+    for (R_xlen_t i = 0; i < n; i++) {
+	uint32_t w;
+	memcpy(&w, s + 4*i, 4);
+	w = bswap32(w);
+	memcpy(d + 4*i, &w, 4);
+    }
+}
+
+static void XDRSwap8(void *dest, const void *src, R_xlen_t n)
+{
+    const char *s = static_cast<const char*>(src);
+    char *d = static_cast<char*>(dest);
+    for (R_xlen_t i = 0; i < n; i++) {
+	uint64_t w;
+	memcpy(&w, s + 8*i, 8);
+	w = bswap64(w);
+	memcpy(d + 8*i, &w, 8);
+    }
+}
+#endif
+
+/* Write n words of the given size (4 or 8) from data, unconverted. */
+static void OutBulk(R_outpstream_t stream, const void *data, R_xlen_t n,
+		    size_t size)
+{
+    const char *p = static_cast<const char*>(data);
+    R_xlen_t chunk = BULK_CHUNK_BYTES / size;
+    R_xlen_t done, thiss;
+    for (done = 0; done < n; done += thiss) {
+	thiss = min2(chunk, n - done);
+	stream->OutBytes(stream, p + done * size, int(thiss * size));
+    }
+}
+
+/* Write n words of the given size (4 or 8) from data in XDR order. */
+static void OutXDRWords(R_outpstream_t stream, const void *data, R_xlen_t n,
+			size_t size)
+{
+#ifdef WORDS_BIGENDIAN
+    OutBulk(stream, data, n, size);
+#else
+    static char buf[CHUNK_SIZE * sizeof(double)];
+    const char *p = static_cast<const char*>(data);
+    R_xlen_t chunk = sizeof(buf) / size;
+    R_xlen_t done, thiss;
+    for (done = 0; done < n; done += thiss) {
+	thiss = min2(chunk, n - done);
+	if (size == 4)
+	    XDRSwap4(buf, p + done * size, thiss);
+	else
+	    XDRSwap8(buf, p + done * size, thiss);
+	stream->OutBytes(stream, buf, int(thiss * size));
+    }
+#endif
+}
+
+/*
+ * Mapped Format Support
+ *
+ * The mapped format ('M') is the native binary format, except that the
+ * payload of each integer, logical, real or complex vector of at least
+ * MAPPED_MIN_BYTES bytes is preceded by an integer n, 0 <= n <
+ * MAPPED_ALIGNMENT, and then n zero bytes, so that the payload starts
+ * at a multiple of MAPPED_ALIGNMENT bytes from the start of the
+ * stream.  When a file in this format is read by
+ * unserializeFromMappedFile(), such vectors are created with their
+ * data in place in a private mapping of the file rather than copied;
+ * any other input stream skips the padding and reads them as usual.
+ * Only the mapped file output stream below tracks the offsets needed
+ * to write this format.
+ */
+
+#define MAPPED_ALIGNMENT 4096
+#define MAPPED_MIN_BYTES (16 * MAPPED_ALIGNMENT)
+
+typedef struct mappedoutbuf_st {
+    FILE *fp;
+    R_size_t offset;
+} *mappedoutbuf_t;
+
+typedef struct mappedinbuf_st {
+    MappedFile *file;
+    R_size_t count;
+} *mappedinbuf_t;
+
+static void InBytesMappedFile(R_inpstream_t stream, void *buf, int length);
+
+static void OutMappedPadding(R_outpstream_t stream, R_size_t nbytes)
+{
+    static const char zeros[MAPPED_ALIGNMENT] = {0};
+    if (nbytes < MAPPED_MIN_BYTES)
+	return;
+    mappedoutbuf_t mb = static_cast<mappedoutbuf_st*>(stream->data);
+    R_size_t start = mb->offset + sizeof(int);
+    int pad = int((MAPPED_ALIGNMENT - start % MAPPED_ALIGNMENT)
+		  % MAPPED_ALIGNMENT);
+    OutInteger(stream, pad);
+    if (pad > 0)
+	stream->OutBytes(stream, zeros, pad);
+}
+
+static void InMappedPadding(R_inpstream_t stream, R_size_t nbytes)
+{
+    char buf[MAPPED_ALIGNMENT];
+    if (nbytes < MAPPED_MIN_BYTES)
+	return;
+    int pad = InInteger(stream);
+    if (pad < 0 || pad >= MAPPED_ALIGNMENT)
+	Rf_error(_("invalid padding in mapped format"));
+    if (pad > 0)
+	stream->InBytes(stream, buf, pad);
+}
+
+/* Whether a vector payload of nbytes bytes can be used in place. */
+static R_INLINE bool IsMappedInput(R_inpstream_t stream, R_size_t nbytes)
+{
+    return stream->InBytes == InBytesMappedFile && nbytes >= MAPPED_MIN_BYTES;
+}
+
+static SEXP InMappedVector(R_inpstream_t stream, SEXPTYPE type,
+			   R_xlen_t length)
+{
+    mappedinbuf_t mb = static_cast<mappedinbuf_st*>(stream->data);
+    size_t eltsize = (type == REALSXP ? sizeof(double)
+		      : type == CPLXSXP ? sizeof(Rcomplex) : sizeof(int));
+    R_size_t nbytes = R_size_t(length) * eltsize;
+    InMappedPadding(stream, nbytes);
+    if (mb->count + nbytes > mb->file->size())
+	Rf_error(_("read error"));
+    char *data = mb->file->data() + mb->count;
+    mb->count += nbytes;
+    switch (type) {
+    case LGLSXP:
+	return LogicalVector::createMapped(length,
+					   reinterpret_cast<Logical*>(data),
+					   mb->file);
+    case INTSXP:
+	return IntVector::createMapped(length, reinterpret_cast<int*>(data),
+				       mb->file);
+    case REALSXP:
+	return RealVector::createMapped(length,
+					reinterpret_cast<double*>(data),
+					mb->file);
+    case CPLXSXP:
+	return ComplexVector::createMapped(length,
+					   reinterpret_cast<Complex*>(data),
+					   mb->file);
+    default:
+	Rf_error(_("unknown type %i in mapped format"), type);
+	return nullptr;
+    }
+}
+
 static R_INLINE void 
 OutIntegerVec(R_outpstream_t stream, SEXP s, R_xlen_t length) 
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-        static char buf[CHUNK_SIZE * sizeof(int)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-	for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(int)), XDR_ENCODE);
-	    for(int cnt = 0; cnt < thiss; cnt++)
-		if(!xdr_int(&xdrs, INTEGER(s) + done + cnt))
-		    Rf_error(_("XDR write failed"));
-	    xdr_destroy(&xdrs);
-	    stream->OutBytes(stream, buf, int(sizeof(int) * thiss));
-	}
+	OutXDRWords(stream, INTEGER(s), length, sizeof(int));
 	break;
-    }
     case R_pstream_binary_format:
-    {
-	/* write in chunks to avoid overflowing ints */
-	R_xlen_t done, thiss;
-	for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->OutBytes(stream, INTEGER(s) + done,
-			     int(sizeof(int) * thiss));
-	}
+	OutBulk(stream, INTEGER(s), length, sizeof(int));
+	break;
+    case R_pstream_mapped_format:
+	OutMappedPadding(stream, length * sizeof(int));
+	OutBulk(stream, INTEGER(s), length, sizeof(int));
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    OutInteger(stream, INTEGER(s)[cnt]);
@@ -904,77 +1117,44 @@ OutRealVec(R_outpstream_t stream, SEXP s, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-        static char buf[CHUNK_SIZE * sizeof(double)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(double)), XDR_ENCODE);
-	    for(int cnt = 0; cnt < thiss; cnt++)
-		if(!xdr_double(&xdrs, REAL(s) + done + cnt))
-		    Rf_error(_("XDR write failed"));
-	    xdr_destroy(&xdrs);
-	    stream->OutBytes(stream, buf, int(sizeof(double) * thiss));
-	}
+	OutXDRWords(stream, REAL(s), length, sizeof(double));
 	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->OutBytes(stream, REAL(s) + done,
-			     int(sizeof(double) * thiss));
-	}
+	OutBulk(stream, REAL(s), length, sizeof(double));
+	break;
+    case R_pstream_mapped_format:
+	OutMappedPadding(stream, length * sizeof(double));
+	OutBulk(stream, REAL(s), length, sizeof(double));
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    OutReal(stream, REAL(s)[cnt]);
     }
 }
 
+/* An Rcomplex is written as its real then imaginary part, so a complex
+   vector is a vector of 2 * length doubles. */
 static R_INLINE void 
 OutComplexVec(R_outpstream_t stream, SEXP s, R_xlen_t length) 
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-        static char buf[CHUNK_SIZE * sizeof(Rcomplex)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-	Rcomplex *c = COMPLEX(s);
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(Rcomplex)), XDR_ENCODE);
-	    for(int cnt = 0; cnt < thiss; cnt++) {
-		if(!xdr_double(&xdrs, &(c[done+cnt].r)) ||
-		   !xdr_double(&xdrs, &(c[done+cnt].i))) 
-		    Rf_error(_("XDR write failed"));
-	    }
-	    stream->OutBytes(stream, buf, int(sizeof(Rcomplex) * thiss));
-	    xdr_destroy(&xdrs);
-	}
+	OutXDRWords(stream, COMPLEX(s), 2 * length, sizeof(double));
 	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->OutBytes(stream, COMPLEX(s) + done, 
-			     int(sizeof(Rcomplex) * thiss));
-	}
+	OutBulk(stream, COMPLEX(s), 2 * length, sizeof(double));
+	break;
+    case R_pstream_mapped_format:
+	OutMappedPadding(stream, 2 * length * sizeof(double));
+	OutBulk(stream, COMPLEX(s), 2 * length, sizeof(double));
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    OutComplex(stream, COMPLEX(s)[cnt]);
     }
 }
 
-static void WriteItem (SEXP s, SEXP ref_table, R_outpstream_t stream)
+static void WriteItem (SEXP s, WriteRefTable* ref_table, R_outpstream_t stream)
 {
     int i;
     SEXP t;
@@ -1165,6 +1345,7 @@ static void WriteItem (SEXP s, SEXP ref_table, R_outpstream_t stream)
 	    switch (stream->type) {
 	    case R_pstream_xdr_format:
 	    case R_pstream_binary_format:
+	    case R_pstream_mapped_format:
 	    {
 		R_xlen_t done, thiss;
 		for (done = 0; done < len; done += thiss) {
@@ -1247,7 +1428,7 @@ static SEXP findrep(SEXP x, SEXP reps)
     return R_NilValue;
 }
 
-static void WriteBCLang(SEXP s, SEXP ref_table, SEXP reps,
+static void WriteBCLang(SEXP s, WriteRefTable* ref_table, SEXP reps,
 			R_outpstream_t stream)
 {
     int type = TYPEOF(s);
@@ -1294,7 +1475,7 @@ static void WriteBCLang(SEXP s, SEXP ref_table, SEXP reps,
     }
 }
 
-static void WriteBC1(SEXP s, SEXP ref_table, SEXP reps, R_outpstream_t stream)
+static void WriteBC1(SEXP s, WriteRefTable* ref_table, SEXP reps, R_outpstream_t stream)
 {
     int i, n;
     SEXP code, consts;
@@ -1324,7 +1505,7 @@ static void WriteBC1(SEXP s, SEXP ref_table, SEXP reps, R_outpstream_t stream)
     UNPROTECT(1);
 }
 
-static void WriteBC(SEXP s, SEXP ref_table, R_outpstream_t stream)
+static void WriteBC(SEXP s, WriteRefTable* ref_table, R_outpstream_t stream)
 {
     SEXP reps = ScanForCircles(s);
     PROTECT(reps = CONS(R_NilValue, reps));
@@ -1337,7 +1518,7 @@ static void WriteBC(SEXP s, SEXP ref_table, R_outpstream_t stream)
 
 void R_Serialize(SEXP s, R_outpstream_t stream)
 {
-    SEXP ref_table;
+    WriteRefTable ref_table;
     int version = stream->version;
 
     OutFormat(stream);
@@ -1351,9 +1532,7 @@ void R_Serialize(SEXP s, R_outpstream_t stream)
     default: Rf_error(_("version %d not supported"), version);
     }
 
-    PROTECT(ref_table = MakeHashTable());
-    WriteItem(s, ref_table, stream);
-    UNPROTECT(1);
+    WriteItem(s, &ref_table, stream);
 }
 
 
@@ -1364,47 +1543,46 @@ void R_Serialize(SEXP s, R_outpstream_t stream)
 attribute_hidden int R_ReadItemDepth = 0, R_InitReadItemDepth;
 static char lastname[8192];
 
+/* The read-side reference table is a flat array, indexed by reference
+   number - 1, of the objects in the order in which they were read.
+   Each entry protects its object. */
+
 #define INITIAL_REFREAD_TABLE_SIZE 128
 
-static SEXP MakeReadRefTable(void)
-{
-    SEXP data = Rf_allocVector(VECSXP, INITIAL_REFREAD_TABLE_SIZE);
-    SET_TRUELENGTH(data, 0);
-    return CONS(data, R_NilValue);
-}
+class ReadRefTable {
+public:
+    ReadRefTable()
+    {
+	m_refs.reserve(INITIAL_REFREAD_TABLE_SIZE);
+    }
 
-static SEXP GetReadRef(SEXP table, int index)
-{
-    int i = index - 1;
-    SEXP data = CAR(table);
+    void add(RObject* value)
+    {
+	m_refs.push_back(GCRoot<>(value));
+    }
 
-    if (i < 0 || i >= LENGTH(data))
-	Rf_error(_("reference index out of range"));
-    return VECTOR_ELT(data, i);
-}
+    RObject* get(int index) const
+    {
+	int i = index - 1;
+	if (i < 0 || size_t(i) >= m_refs.size())
+	    Rf_error(_("reference index out of range"));
+	return m_refs[i];
+    }
+private:
+    vector<GCRoot<> > m_refs;
+};
 
-static void AddReadRef(SEXP table, SEXP value)
+static R_INLINE SEXP GetReadRef(ReadRefTable* table, int index)
 {
-    SEXP data = CAR(table);
-    int count = TRUELENGTH(data) + 1;
-    if (count >= LENGTH(data)) {
-	int i, len;
-	SEXP newdata;
+    return table->get(index);
+}
 
-	PROTECT(value);
-	len = 2 * count;
-	newdata = Rf_allocVector(VECSXP, len);
-	for (i = 0; i < LENGTH(data); i++)
-	    SET_VECTOR_ELT(newdata, i, VECTOR_ELT(data, i));
-	SETCAR(table, newdata);
-	data = newdata;
-	UNPROTECT(1);
-    }
-    SET_TRUELENGTH(data, count);
-    SET_VECTOR_ELT(data, count - 1, value);
+static R_INLINE void AddReadRef(ReadRefTable* table, SEXP value)
+{
+    table->add(value);
 }
 
-static SEXP InStringVec(R_inpstream_t stream, SEXP ref_table)
+static SEXP InStringVec(R_inpstream_t stream, ReadRefTable* ref_table)
 {
     SEXP s;
     int i, len;
@@ -1420,37 +1598,46 @@ static SEXP InStringVec(R_inpstream_t stream, SEXP ref_table)
     return s;
 }
 
-/* use static buffer to reuse storage */
+/* Read n words of the given size (4 or 8) into data, unconverted. */
+static void InBulk(R_inpstream_t stream, void *data, R_xlen_t n, size_t size)
+{
+    char *p = static_cast<char*>(data);
+    R_xlen_t chunk = BULK_CHUNK_BYTES / size;
+    R_xlen_t done, thiss;
+    for (done = 0; done < n; done += thiss) {
+	thiss = min2(chunk, n - done);
+	stream->InBytes(stream, p + done * size, int(thiss * size));
+    }
+}
+
+/* Read n words of the given size (4 or 8) in XDR order into data.  The
+   payload is read straight into the vector and converted in place. */
+static void InXDRWords(R_inpstream_t stream, void *data, R_xlen_t n,
+		       size_t size)
+{
+    InBulk(stream, data, n, size);
+#ifndef WORDS_BIGENDIAN
+    if (size == 4)
+	XDRSwap4(data, data, n);
+    else
+	XDRSwap8(data, data, n);
+#endif
+}
+
 static R_INLINE void 
 InIntegerVec(R_inpstream_t stream, SEXP obj, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-        static char buf[CHUNK_SIZE * sizeof(int)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, buf, int(sizeof(int) * thiss));
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(int)), XDR_DECODE);
-	    for(int cnt = 0; cnt < thiss; cnt++)
-		if(!xdr_int(&xdrs, INTEGER(obj) + done + cnt))
-		    Rf_error(_("XDR read failed"));
-	    xdr_destroy(&xdrs);
-	}
+	InXDRWords(stream, INTEGER(obj), length, sizeof(int));
 	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, INTEGER(obj) + done,
-			    int(sizeof(int) * thiss));
-	}
+	InBulk(stream, INTEGER(obj), length, sizeof(int));
+	break;
+    case R_pstream_mapped_format:
+	InMappedPadding(stream, length * sizeof(int));
+	InBulk(stream, INTEGER(obj), length, sizeof(int));
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    INTEGER(obj)[cnt] = InInteger(stream);
@@ -1462,31 +1649,15 @@ InRealVec(R_inpstream_t stream, SEXP obj, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-        static char buf[CHUNK_SIZE * sizeof(double)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, buf, int(sizeof(double) * thiss));
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(double)), XDR_DECODE);
-	    for(R_xlen_t cnt = 0; cnt < thiss; cnt++)
-		if(!xdr_double(&xdrs, REAL(obj) + done + cnt))
-		    Rf_error(_("XDR read failed"));
-	    xdr_destroy(&xdrs);
-	}
+	InXDRWords(stream, REAL(obj), length, sizeof(double));
 	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, REAL(obj) + done,
-			    int(sizeof(double) * thiss));
-	}
+	InBulk(stream, REAL(obj), length, sizeof(double));
+	break;
+    case R_pstream_mapped_format:
+	InMappedPadding(stream, length * sizeof(double));
+	InBulk(stream, REAL(obj), length, sizeof(double));
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    REAL(obj)[cnt] = InReal(stream);
@@ -1498,34 +1669,15 @@ InComplexVec(R_inpstream_t stream, SEXP obj, R_xlen_t length)
 {
     switch (stream->type) {
     case R_pstream_xdr_format:
-    {
-        static char buf[CHUNK_SIZE * sizeof(Rcomplex)];
-	R_xlen_t done, thiss;
-	XDR xdrs;
-	Rcomplex *output = COMPLEX(obj);
-	for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, buf, int(sizeof(Rcomplex) * thiss));
-	    xdrmem_create(&xdrs, buf, int(thiss * sizeof(Rcomplex)), XDR_DECODE);
-	    for(R_xlen_t cnt = 0; cnt < thiss; cnt++) {
-		if(!xdr_double(&xdrs, &(output[done+cnt].r)) ||
-		   !xdr_double(&xdrs, &(output[done+cnt].i)))
-		    Rf_error(_("XDR read failed"));
-	    }
-	    xdr_destroy(&xdrs);
-	}
+	InXDRWords(stream, COMPLEX(obj), 2 * length, sizeof(double));
 	break;
-    }
     case R_pstream_binary_format:
-    {
-	R_xlen_t done, thiss;
-        for (done = 0; done < length; done += thiss) {
-	    thiss = min2(CHUNK_SIZE, length - done);
-	    stream->InBytes(stream, COMPLEX(obj) + done, 
-			    int(sizeof(Rcomplex) * thiss));
-	}
+	InBulk(stream, COMPLEX(obj), 2 * length, sizeof(double));
+	break;
+    case R_pstream_mapped_format:
+	InMappedPadding(stream, 2 * length * sizeof(double));
+	InBulk(stream, COMPLEX(obj), 2 * length, sizeof(double));
 	break;
-    }
     default:
 	for (R_xlen_t cnt = 0; cnt < length; cnt++)
 	    COMPLEX(obj)[cnt] = InComplex(stream);
@@ -1570,15 +1722,13 @@ static SEXP R_FindNamespace1(SEXP info)
 }
 
 
-static SEXP ReadItem (SEXP ref_table, R_inpstream_t stream)
+static SEXP ReadItem (ReadRefTable* ref_table, R_inpstream_t stream)
 {
     int type;
     SEXP s;
     R_xlen_t len, count;
     int flags, levs, objf, hasattr, hastag, length;
 
-    R_assert(TYPEOF(ref_table) == LISTSXP && TYPEOF(CAR(ref_table)) == VECSXP);
-
     flags = InInteger(stream);
     UnpackFlags(flags, &type, &levs, &objf, &hasattr, &hastag);
 
@@ -1810,18 +1960,30 @@ static SEXP ReadItem (SEXP ref_table, R_inpstream_t stream)
 	case LGLSXP:
 	case INTSXP:
 	    len = ReadLENGTH(stream);
-	    PROTECT(s = Rf_allocVector(SEXPTYPE(type), len));
-	    InIntegerVec(stream, s, len);
+	    if (IsMappedInput(stream, len * sizeof(int)))
+		PROTECT(s = InMappedVector(stream, SEXPTYPE(type), len));
+	    else {
+		PROTECT(s = Rf_allocVector(SEXPTYPE(type), len));
+		InIntegerVec(stream, s, len);
+	    }
 	    break;
 	case REALSXP:
 	    len = ReadLENGTH(stream);
-	    PROTECT(s = Rf_allocVector(REALSXP, len));
-	    InRealVec(stream, s, len);
+	    if (IsMappedInput(stream, len * sizeof(double)))
+		PROTECT(s = InMappedVector(stream, REALSXP, len));
+	    else {
+		PROTECT(s = Rf_allocVector(REALSXP, len));
+		InRealVec(stream, s, len);
+	    }
 	    break;
 	case CPLXSXP:
 	    len = ReadLENGTH(stream);
-	    PROTECT(s = Rf_allocVector(CPLXSXP, len));
-	    InComplexVec(stream, s, len);
+	    if (IsMappedInput(stream, len * sizeof(Rcomplex)))
+		PROTECT(s = InMappedVector(stream, CPLXSXP, len));
+	    else {
+		PROTECT(s = Rf_allocVector(CPLXSXP, len));
+		InComplexVec(stream, s, len);
+	    }
 	    break;
 	case STRSXP:
 	    len = ReadLENGTH(stream);
@@ -1890,9 +2052,9 @@ static SEXP ReadItem (SEXP ref_table, R_inpstream_t stream)
     }
 }
 
-static SEXP ReadBC1(SEXP ref_table, SEXP reps, R_inpstream_t stream);
+static SEXP ReadBC1(ReadRefTable* ref_table, SEXP reps, R_inpstream_t stream);
 
-static SEXP ReadBCLang(int type, SEXP ref_table, SEXP reps,
+static SEXP ReadBCLang(int type, ReadRefTable* ref_table, SEXP reps,
 		       R_inpstream_t stream)
 {
     switch (type) {
@@ -1940,7 +2102,7 @@ static SEXP ReadBCLang(int type, SEXP ref_table, SEXP reps,
     }
 }
 
-static SEXP ReadBCConsts(SEXP ref_table, SEXP reps, R_inpstream_t stream)
+static SEXP ReadBCConsts(ReadRefTable* ref_table, SEXP reps, R_inpstream_t stream)
 {
     SEXP ans, c;
     int i, n;
@@ -1972,7 +2134,7 @@ static SEXP ReadBCConsts(SEXP ref_table, SEXP reps, R_inpstream_t stream)
     return ans;
 }
 
-static SEXP ReadBC1(SEXP ref_table, SEXP reps, R_inpstream_t stream)
+static SEXP ReadBC1(ReadRefTable* ref_table, SEXP reps, R_inpstream_t stream)
 {
     R_ReadItemDepth++;
     GCStackRoot<> code(ReadItem(ref_table, stream));
@@ -1982,7 +2144,7 @@ static SEXP ReadBC1(SEXP ref_table, SEXP reps, R_inpstream_t stream)
 			SEXP_downcast<ListVector*>(constants.get()));
 }
 
-static SEXP ReadBC(SEXP ref_table, R_inpstream_t stream)
+static SEXP ReadBC(ReadRefTable* ref_table, R_inpstream_t stream)
 {
     SEXP reps, ans;
     PROTECT(reps = Rf_allocVector(VECSXP, InInteger(stream)));
@@ -2002,7 +2164,8 @@ SEXP R_Unserialize(R_inpstream_t stream)
 {
     int version;
     int writer_version, release_version;
-    SEXP obj, ref_table;
+    SEXP obj;
+    ReadRefTable ref_table;
 
     InFormat(stream);
 
@@ -2028,9 +2191,7 @@ SEXP R_Unserialize(R_inpstream_t stream)
     }
 
     /* Read the actual object back */
-    PROTECT(ref_table = MakeReadRefTable());
-    obj =  ReadItem(ref_table, stream);
-    UNPROTECT(1);
+    obj =  ReadItem(&ref_table, stream);
 
     return obj;
 }
@@ -2377,6 +2538,123 @@ do_unserializeFromConn(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunc
 }
 
 
+/*
+ * Persistent Mapped File Streams
+ *
+ * Used by saveRDS(compress = "mmap") and readRDS() for the mapped
+ * format; see "Mapped Format Support" above.
+ */
+
+static void OutCharMappedFile(R_outpstream_t stream, int c)
+{
+    mappedoutbuf_t mb = static_cast<mappedoutbuf_st*>(stream->data);
+    if (fputc(c, mb->fp) == EOF)
+	Rf_error(_("write failed"));
+    mb->offset++;
+}
+
+static void OutBytesMappedFile(R_outpstream_t stream, const void *buf,
+			       int length)
+{
+    mappedoutbuf_t mb = static_cast<mappedoutbuf_st*>(stream->data);
+    size_t out = fwrite(buf, 1, length, mb->fp);
+    if (int(out) != length) Rf_error(_("write failed"));
+    mb->offset += length;
+}
+
+static int InCharMappedFile(R_inpstream_t stream)
+{
+    mappedinbuf_t mb = static_cast<mappedinbuf_st*>(stream->data);
+    if (mb->count >= mb->file->size())
+	Rf_error(_("read error"));
+    return static_cast<unsigned char>(mb->file->data()[mb->count++]);
+}
+
+static void InBytesMappedFile(R_inpstream_t stream, void *buf, int length)
+{
+    mappedinbuf_t mb = static_cast<mappedinbuf_st*>(stream->data);
+    if (mb->count + R_size_t(length) > mb->file->size())
+	Rf_error(_("read error"));
+    memcpy(buf, mb->file->data() + mb->count, length);
+    mb->count += length;
+}
+
+/* Used from saveRDS(compress = "mmap") */
+SEXP attribute_hidden
+do_serializeToMappedFile(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
+{
+    /* serializeToMappedFile(object, file, version, hook) */
+
+    struct R_outpstream_st out;
+    struct mappedoutbuf_st mbs;
+    SEXP file = args[1], fun = args[3];
+    SEXP (*hook)(SEXP, SEXP);
+    int version;
+
+    op->checkNumArgs(num_args, call);
+
+    if (!Rf_isString(file) || LENGTH(file) != 1 || STRING_ELT(file, 0) == NA_STRING)
+	Rf_error(_("invalid '%s' argument"), "file");
+    if (args[2] == R_NilValue)
+	version = R_DefaultSerializeVersion;
+    else
+	version = Rf_asInteger(args[2]);
+    if (version == NA_INTEGER || version <= 0)
+	Rf_error(_("bad version value"));
+    hook = fun != R_NilValue ? CallHook : nullptr;
+
+    const char *path = R_ExpandFileName(Rf_translateChar(STRING_ELT(file, 0)));
+    if ((mbs.fp = R_fopen(path, "wb")) == nullptr)
+	Rf_error(_("cannot open file '%s': %s"), path, strerror(errno));
+    mbs.offset = 0;
+    try {
+	R_InitOutPStream(&out, &mbs, R_pstream_mapped_format, version,
+			 OutCharMappedFile, OutBytesMappedFile, hook, fun);
+	R_Serialize(args[0], &out);
+    } catch (...) {
+	fclose(mbs.fp);
+	throw;
+    }
+    if (fclose(mbs.fp) != 0)
+	Rf_error(_("write failed"));
+    return R_NilValue;
+}
+
+/* Used from readRDS() for files in the mapped format */
+SEXP attribute_hidden
+do_unserializeFromMappedFile(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
+{
+    /* unserializeFromMappedFile(file, hook) */
+
+    struct R_inpstream_st in;
+    struct mappedinbuf_st mbs;
+    SEXP file = args[0], fun = args[1];
+    SEXP (*hook)(SEXP, SEXP);
+
+    op->checkNumArgs(num_args, call);
+
+    if (!Rf_isString(file) || LENGTH(file) != 1 || STRING_ELT(file, 0) == NA_STRING)
+	Rf_error(_("invalid '%s' argument"), "file");
+    hook = fun != R_NilValue ? CallHook : nullptr;
+
+    const char *path = R_ExpandFileName(Rf_translateChar(STRING_ELT(file, 0)));
+    mbs.file = MappedFile::open(path);
+    mbs.count = 0;
+    GCStackRoot<> ans;
+    try {
+	R_InitInPStream(&in, &mbs, R_pstream_mapped_format,
+			InCharMappedFile, InBytesMappedFile, hook, fun);
+	ans = R_Unserialize(&in);
+    } catch (...) {
+	mbs.file->decRef();
+	throw;
+    }
+    /* Vectors created in place hold their own references. */
+    mbs.file->decRef();
+    return ans;
+}
+
+
 /*
  * Persistent Buffered Binary Connection Streams
  */
@@ -2713,123 +2991,244 @@ static SEXP appendRawToFile(SEXP file, SEXP bytes)
 
 /* Interface to cache the pkg.rdb files */
 
-#define NC 100
-static int used = 0;
-static char names[NC][PATH_MAX];
-static char *ptr[NC];
+/* Each database is memory-mapped (read into memory on Windows) when
+   first used, and stays so until flushed or until the file is found to
+   have changed: objects stored uncompressed are unserialized straight
+   from the mapping.  Decompressed objects
+   are kept, indexed by database and offset, in a cache of at most
+   LAZYLOAD_CACHE_BYTES bytes from which the least recently used are
+   dropped, and which lazyLoadDBprefetch fills on several threads. */
 
-SEXP attribute_hidden 
-do_lazyLoadDBflush(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
-{
-    op->checkNumArgs(num_args, call);
+#define LAZYLOAD_CACHE_BYTES (64*1048576)
 
-    int i;
-    const char *cfile = CHAR(STRING_ELT(args[0], 0));
-
-    /* fprintf(stderr, "flushing file %s", cfile); */
-    for (i = 0; i < used; i++)
-	if(strcmp(cfile, names[i]) == 0) {
-	    strcpy(names[i], "");
-	    free(ptr[i]);
-	    /* fprintf(stderr, " found at pos %d in cache", i); */
-	    break;
-	}
-    /* fprintf(stderr, "\n"); */
-    return R_NilValue;
-}
+attribute_hidden
+Rboolean R_decompressBuffer(int method, const unsigned char *in,
+			    size_t inlen, unsigned char *out, size_t outlen);
 
+namespace {
+    typedef std::shared_ptr<std::vector<unsigned char> > RdbBlob;
 
-/* Reads, in binary mode, the bytes in the range specified by a
-   position/length vector and returns them as raw vector. */
+    struct RdbCacheEntry;
+    typedef std::list<RdbCacheEntry>::iterator RdbCacheIter;
 
-/* There are some large lazy-data examples, e.g. 80Mb for SNPMaP.cdm */
-#define LEN_LIMIT 10*1048576
-static SEXP readRawFromFile(SEXP file, SEXP key)
-{
-    FILE *fp;
-    int offset, len, in, i, icache = -1;
-    long filelen;
-    SEXP val;
-    const char *cfile = CHAR(STRING_ELT(file, 0));
+    struct RdbFile {
+	std::string path;
+#ifdef Win32
+	RdbBlob contents;
+#else
+	MappedFile* map;
+#endif
+	const unsigned char* data;
+	size_t size;
+	struct stat st;  // of the file when opened
+	std::unordered_map<int, RdbCacheIter> index;  // by offset
+    };
+
+    struct RdbCacheEntry {
+	RdbFile* file;
+	int offset;
+	RdbBlob blob;
+    };
+
+    std::map<std::string, RdbFile*> s_rdb_files;
+    std::list<RdbCacheEntry> s_rdb_cache;  // most recently used first
+    size_t s_rdb_cache_bytes = 0;
+
+    void dropRdbCacheEntry(RdbCacheIter it)
+    {
+	it->file->index.erase(it->offset);
+	s_rdb_cache_bytes -= it->blob->size();
+	s_rdb_cache.erase(it);
+    }
 
-    if (! IS_PROPER_STRING(file))
-	Rf_error(_("not a proper file name"));
-    if (TYPEOF(key) != INTSXP || LENGTH(key) != 2)
-	Rf_error(_("bad offset/length argument"));
-
-    offset = INTEGER(key)[0];
-    len = INTEGER(key)[1];
-
-    val = Rf_allocVector(RAWSXP, len);
-    /* Do we have this database cached? */
-    for (i = 0; i < used; i++)
-	if(strcmp(cfile, names[i]) == 0) {icache = i; break;}
-    if (icache >= 0) {
-	memcpy(RAW(val), ptr[icache]+offset, len);
-	return val;
+    void closeRdb(std::map<std::string, RdbFile*>::iterator it)
+    {
+	RdbFile* db = it->second;
+	while (!db->index.empty())
+	    dropRdbCacheEntry(db->index.begin()->second);
+	s_rdb_files.erase(it);
+#ifndef Win32
+	/* Objects being unserialized from the mapping hold their own
+	   references to it. */
+	db->map->decRef();
+#endif
+	delete db;
     }
 
-    /* find a vacant slot? */
-    for (i = 0; i < used; i++)
-	if(strcmp("", names[i]) == 0) {icache = i; break;}
-    if(icache < 0 && used < NC) icache = used++;
+    /* Whether the file has been replaced, or rewritten (in particular
+       truncated, so that using the mapping would fault) since it was
+       opened. */
+    bool rdbChanged(const RdbFile* db)
+    {
+	struct stat sb;
+	if (stat(R_ExpandFileName(db->path.c_str()), &sb) != 0)
+	    return true;
+	return sb.st_dev != db->st.st_dev || sb.st_ino != db->st.st_ino
+	    || sb.st_size != db->st.st_size || sb.st_mtime != db->st.st_mtime;
+    }
 
-    if(icache >= 0) {
-	if ((fp = R_fopen(cfile, "rb")) == nullptr)
+    RdbFile* openRdb(SEXP file)
+    {
+	if (!IS_PROPER_STRING(file))
+	    Rf_error(_("not a proper file name"));
+	const char *cfile = CHAR(STRING_ELT(file, 0));
+	auto it = s_rdb_files.find(cfile);
+	if (it != s_rdb_files.end()) {
+	    if (!rdbChanged(it->second))
+		return it->second;
+	    closeRdb(it);
+	}
+	std::unique_ptr<RdbFile> db(new RdbFile);
+	db->path = cfile;
+	if (stat(R_ExpandFileName(cfile), &db->st) != 0)
+	    Rf_error(_("cannot open file '%s': %s"), cfile, strerror(errno));
+#ifdef Win32
+	FILE *fp = R_fopen(cfile, "rb");
+	if (!fp)
 	    Rf_error(_("cannot open file '%s': %s"), cfile, strerror(errno));
-	if (fseek(fp, 0, SEEK_END) != 0) {
+	long filelen = -1;
+	if (fseek(fp, 0, SEEK_END) == 0) filelen = ftell(fp);
+	if (filelen < 0 || fseek(fp, 0, SEEK_SET) != 0) {
 	    fclose(fp);
 	    Rf_error(_("seek failed on %s"), cfile);
 	}
-	filelen = ftell(fp);
-	if (filelen < LEN_LIMIT) {
-	    char *p;
-	    /* fprintf(stderr, "adding file '%s' at pos %d in cache, length %d\n",
-	       cfile, icache, filelen); */
-	    p = static_cast<char *>( malloc(filelen));
-	    if (p) {
-		strcpy(names[icache], cfile);
-		ptr[icache] = p;
-		if (fseek(fp, 0, SEEK_SET) != 0) {
-		    fclose(fp);
-		    Rf_error(_("seek failed on %s"), cfile);
-		}
-		in = int( fread(p, 1, filelen, fp));
-		fclose(fp);
-		if (filelen != in) Rf_error(_("read failed on %s"), cfile);
-		memcpy(RAW(val), p+offset, len);
-	    } else {
-		if (fseek(fp, offset, SEEK_SET) != 0) {
-		    fclose(fp);
-		    Rf_error(_("seek failed on %s"), cfile);
-		}
-		in = int( fread(RAW(val), 1, len, fp));
-		fclose(fp);
-		if (len != in) Rf_error(_("read failed on %s"), cfile);
-	    }
-	    return val;
-	} else {
-	    if (fseek(fp, offset, SEEK_SET) != 0) {
-		fclose(fp);
-		Rf_error(_("seek failed on %s"), cfile);
-	    }
-	    in = int( fread(RAW(val), 1, len, fp));
-	    fclose(fp);
-	    if (len != in) Rf_error(_("read failed on %s"), cfile);
-	    return val;
-	}
+	db->contents = std::make_shared<std::vector<unsigned char> >(filelen);
+	size_t in = fread(db->contents->data(), 1, filelen, fp);
+	fclose(fp);
+	if (in != size_t(filelen)) Rf_error(_("read failed on %s"), cfile);
+	db->data = db->contents->data();
+	db->size = filelen;
+#else
+	db->map = MappedFile::open(R_ExpandFileName(cfile));
+	db->data = reinterpret_cast<unsigned char*>(db->map->data());
+	db->size = db->map->size();
+#endif
+	RdbFile* ans = db.release();
+	s_rdb_files[ans->path] = ans;
+	return ans;
     }
 
-    if ((fp = R_fopen(cfile, "rb")) == nullptr)
-	Rf_error(_("cannot open file '%s': %s"), cfile, strerror(errno));
-    if (fseek(fp, offset, SEEK_SET) != 0) {
-	fclose(fp);
-	Rf_error(_("seek failed on %s"), cfile);
+    RdbBlob findRdbBlob(RdbFile* db, int offset)
+    {
+	auto it = db->index.find(offset);
+	if (it == db->index.end())
+	    return RdbBlob();
+	/* move to the front */
+	s_rdb_cache.splice(s_rdb_cache.begin(), s_rdb_cache, it->second);
+	return it->second->blob;
     }
-    in = int( fread(RAW(val), 1, len, fp));
-    fclose(fp);
-    if (len != in) Rf_error(_("read failed on %s"), cfile);
-    return val;
+
+    void addRdbBlob(RdbFile* db, int offset, RdbBlob blob)
+    {
+	if (blob->size() > LAZYLOAD_CACHE_BYTES/4
+	    || db->index.count(offset))
+	    return;
+	while (!s_rdb_cache.empty()
+	       && s_rdb_cache_bytes + blob->size() > LAZYLOAD_CACHE_BYTES)
+	    dropRdbCacheEntry(std::prev(s_rdb_cache.end()));
+	RdbCacheEntry entry = {db, offset, blob};
+	s_rdb_cache.push_front(entry);
+	db->index[offset] = s_rdb_cache.begin();
+	s_rdb_cache_bytes += blob->size();
+    }
+
+    /* Checks a position/length key against the database, returning the
+       start of the bytes it refers to. */
+    const unsigned char* rdbBytes(RdbFile* db, SEXP key, int* offset,
+				  int* len)
+    {
+	if (TYPEOF(key) != INTSXP || LENGTH(key) != 2)
+	    Rf_error(_("bad offset/length argument"));
+	*offset = INTEGER(key)[0];
+	*len = INTEGER(key)[1];
+	if (*offset < 0 || *len < 0
+	    || size_t(*offset) + size_t(*len) > db->size)
+	    Rf_error(_("read failed on %s"), db->path.c_str());
+	return db->data + *offset;
+    }
+
+    /* The length recorded in the header of compressed data. */
+    size_t decompressedLength(const unsigned char* p)
+    {
+	return (size_t(p[0]) << 24) | (size_t(p[1]) << 16)
+	    | (size_t(p[2]) << 8) | size_t(p[3]);
+    }
+}
+
+SEXP attribute_hidden 
+do_lazyLoadDBflush(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
+{
+    op->checkNumArgs(num_args, call);
+
+    const char *cfile = CHAR(STRING_ELT(args[0], 0));
+    auto it = s_rdb_files.find(cfile);
+    if (it != s_rdb_files.end())
+	closeRdb(it);
+    return R_NilValue;
+}
+
+/* Decompresses, on up to R_num_math_threads threads, the objects of a
+   lazy-load database given by a list of position/length keys, and
+   adds them to the cache so that fetching them needs only
+   unserialization.  Stops when the cache is full. */
+SEXP attribute_hidden
+do_lazyLoadDBprefetch(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
+{
+    op->checkNumArgs(num_args, call);
+    SEXP keys = args[0];
+    int compressed = Rf_asInteger(args[2]);
+    if (TYPEOF(keys) != VECSXP)
+	Rf_error(_("invalid '%s' argument"), "keys");
+    if (XLENGTH(keys) == 0)
+	return R_NilValue;
+    RdbFile* db = openRdb(args[1]);
+    if (compressed == NA_INTEGER || compressed < 1 || compressed > 3)
+	return R_NilValue;
+
+    struct Job {
+	int offset;
+	const unsigned char* in;
+	size_t inlen;
+	RdbBlob blob;
+	bool ok;
+    };
+    std::vector<Job> jobs;
+    size_t bytes = s_rdb_cache_bytes;
+    for (R_xlen_t i = 0; i < XLENGTH(keys); i++) {
+	int offset, len;
+	const unsigned char* p = rdbBytes(db, VECTOR_ELT(keys, i),
+					  &offset, &len);
+	if (len < 4 || db->index.count(offset))
+	    continue;
+	size_t outlen = decompressedLength(p);
+	if (outlen > LAZYLOAD_CACHE_BYTES/4)
+	    continue;
+	if (bytes + outlen > LAZYLOAD_CACHE_BYTES)
+	    break;
+	bytes += outlen;
+	Job job = {offset, p, size_t(len),
+		   std::make_shared<std::vector<unsigned char> >(outlen),
+		   false};
+	jobs.push_back(job);
+    }
+
+    int njobs = int(jobs.size());
+#ifdef _OPENMP
+    int nthreads = R_num_math_threads > 0 ? R_num_math_threads : 1;
+    if (njobs < 2) nthreads = 1;
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (int i = 0; i < njobs; i++) {
+	Job& job = jobs[i];
+	job.ok = R_decompressBuffer(compressed, job.in, job.inlen,
+				    job.blob->data(), job.blob->size());
+    }
+
+    /* Corrupt objects are left to be reported when fetched. */
+    for (Job& job : jobs)
+	if (job.ok)
+	    addRdbBlob(db, job.offset, job.blob);
+    return R_NilValue;
 }
 
 /* Gets the binding values of variables from a frame and returns them
@@ -2921,9 +3320,7 @@ SEXP attribute_hidden
 do_lazyLoadDBfetch(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* env, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
 {
     SEXP key, file, compsxp, hook;
-    PROTECT_INDEX vpi;
-    int compressed;
-    Rboolean err = FALSE;
+    int compressed, offset, len;
     SEXP val;
 
     op->checkNumArgs(num_args, call);
@@ -2933,22 +3330,50 @@ do_lazyLoadDBfetch(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction
     hook = args[0];
     compressed = Rf_asInteger(compsxp);
 
-    PROTECT_WITH_INDEX(val = readRawFromFile(file, key), &vpi);
-    if (compressed == 3)
-	REPROTECT(val = R_decompress3(val, &err), vpi);
-    else if (compressed == 2)
-	REPROTECT(val = R_decompress2(val, &err), vpi);
-    else if (compressed)
-	REPROTECT(val = R_decompress1(val, &err), vpi);
-    if (err) Rf_error("lazy-load database '%s' is corrupt",
-		      CHAR(STRING_ELT(file, 0)));
-    val = R_unserialize(val, hook);
+    RdbFile* db = openRdb(file);
+    const unsigned char* p = rdbBytes(db, key, &offset, &len);
+    SEXP (*inhook)(SEXP, SEXP) = hook != R_NilValue ? CallHook : nullptr;
+    struct R_inpstream_st in;
+    struct membuf_st mbs;
+    if (compressed) {
+	/* Unserializing may fetch from the database again, which could
+	   evict this blob from the cache, so keep hold of it. */
+	RdbBlob blob = findRdbBlob(db, offset);
+	if (!blob) {
+	    if (len < 4)
+		Rf_error("lazy-load database '%s' is corrupt",
+			 CHAR(STRING_ELT(file, 0)));
+	    blob = std::make_shared<std::vector<unsigned char> >
+		(decompressedLength(p));
+	    if (!R_decompressBuffer(compressed, p, len,
+				    blob->data(), blob->size()))
+		Rf_error("lazy-load database '%s' is corrupt",
+			 CHAR(STRING_ELT(file, 0)));
+	    addRdbBlob(db, offset, blob);
+	}
+	InitMemInPStream(&in, &mbs, blob->data(), blob->size(), inhook, hook);
+	val = R_Unserialize(&in);
+    } else {
+	/* Likewise the database could be flushed. */
+#ifdef Win32
+	RdbBlob contents = db->contents;
+#else
+	struct MapRef {
+	    MappedFile* map;
+	    MapRef(MappedFile* m) : map(m) { map->incRef(); }
+	    ~MapRef() { map->decRef(); }
+	} mapref(db->map);
+#endif
+	InitMemInPStream(&in, &mbs, const_cast<unsigned char*>(p), len,
+			 inhook, hook);
+	val = R_Unserialize(&in);
+    }
     if (TYPEOF(val) == PROMSXP) {
-	REPROTECT(val, vpi);
+	PROTECT(val);
 	val = Rf_eval(val, R_GlobalEnv);
 	SET_NAMED(val, 2);
+	UNPROTECT(1);
     }
-    UNPROTECT(1);
     return val;
 }
 
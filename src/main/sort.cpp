@@ -35,6 +35,10 @@
 #include <R_ext/RS.h>  /* for Calloc/Free */
 
 #include "CXXR/RAllocStack.h"
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
 
 // 'using namespace std' causes ambiguity of 'greater'
 using namespace CXXR;
@@ -465,6 +469,229 @@ static void ssort2(StringVector* sv, R_xlen_t n, Rboolean decreasing)
 	}
 }
 
+/* Radix ordering for integer, logical and real keys.
+
+   Each element is mapped onto an unsigned integer key whose natural
+   order is the order required by order() for the given 'nalast' and
+   'decreasing': NAs and NaNs (which compare equal to each other)
+   collate at the requested end irrespective of 'decreasing', and -0
+   collates with 0.  The keys are then sorted by a least significant
+   digit radix sort, which is stable, so ties retain their incoming
+   order exactly as with the comparison sorts in this file.  Above
+   R_RADIX_PARALLEL_MIN elements, and if more than one math thread is
+   enabled, chunks are radix sorted concurrently and then merged.
+*/
+
+/* Below this length the Shell sorts are as fast: */
+#define R_RADIX_ORDER_MIN 256
+#define R_RADIX_PARALLEL_MIN 1000000
+
+static bool radixOrderable(SEXP x)
+{
+    switch (TYPEOF(x)) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+	return true;
+    default:
+	return false;
+    }
+}
+
+static inline uint32_t intRadixKey(int x, Rboolean nalast,
+				   Rboolean decreasing)
+{
+    if (x == NA_INTEGER)
+	return nalast ? UINT32_MAX : 0;
+    // Maps INT_MIN + 1 ... INT_MAX onto 1 ... UINT32_MAX:
+    uint32_t u = uint32_t(x) ^ 0x80000000u;
+    if (decreasing)
+	u = 0u - u;  // Still within 1 ... UINT32_MAX.
+    return nalast ? u - 1 : u;
+}
+
+static inline uint64_t realRadixKey(double x, Rboolean nalast,
+				    Rboolean decreasing)
+{
+    if (ISNAN(x))
+	return nalast ? UINT64_MAX : 0;
+    if (x == 0.0)
+	x = 0.0;
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    // Negative values have all their bits flipped, non-negative
+    // values only the sign bit.  Non-NaN values (including the
+    // infinities) thereby map strictly between 0 and UINT64_MAX:
+    u = (u & 0x8000000000000000ull) ? ~u : (u | 0x8000000000000000ull);
+    return decreasing ? ~u : u;
+}
+
+template <typename Key, typename Index>
+struct RadixItem {
+    Key key;
+    Index index;
+
+    bool operator<(const RadixItem& other) const
+    {
+	return key < other.key;
+    }
+};
+
+// Stable sort of items[0 .. n-1] by key, one byte per pass, using
+// scratch[0 .. n-1] as workspace.  Passes over a byte shared by
+// every key are skipped.
+template <typename Key, typename Index>
+static void radixSortItems(RadixItem<Key, Index>* items,
+			   RadixItem<Key, Index>* scratch, R_xlen_t n)
+{
+    const int nbytes = sizeof(Key);
+    if (n < 2)
+	return;
+    std::vector<R_xlen_t> counts(nbytes*256, 0);
+    for (R_xlen_t i = 0; i < n; ++i) {
+	Key k = items[i].key;
+	for (int b = 0; b < nbytes; ++b)
+	    counts[b*256 + ((k >> 8*b) & 0xff)]++;
+    }
+    RadixItem<Key, Index>* from = items;
+    RadixItem<Key, Index>* to = scratch;
+    for (int b = 0; b < nbytes; ++b) {
+	R_xlen_t* cnt = &counts[b*256];
+	if (cnt[(from[0].key >> 8*b) & 0xff] == n)
+	    continue;
+	R_xlen_t pos = 0;
+	for (int d = 0; d < 256; ++d) {
+	    R_xlen_t c = cnt[d];
+	    cnt[d] = pos;
+	    pos += c;
+	}
+	for (R_xlen_t i = 0; i < n; ++i)
+	    to[cnt[(from[i].key >> 8*b) & 0xff]++] = from[i];
+	std::swap(from, to);
+    }
+    if (from != items)
+	std::copy(from, from + n, items);
+}
+
+template <typename Key, typename Index>
+static void radixSort(std::vector<RadixItem<Key, Index> >& items)
+{
+    typedef RadixItem<Key, Index> Item;
+    R_xlen_t n = items.size();
+    std::vector<Item> scratch(n);
+    Item* data = &items[0];
+    Item* work = &scratch[0];
+#ifdef _OPENMP
+    int nthreads = (R_num_math_threads > 0 ? R_num_math_threads : 1);
+    if (nthreads > 1 && n >= R_RADIX_PARALLEL_MIN) {
+	R_xlen_t chunk = (n + nthreads - 1)/nthreads;
+#pragma omp parallel for num_threads(nthreads)
+	for (int t = 0; t < nthreads; ++t) {
+	    R_xlen_t lo = t*chunk, hi = std::min(n, lo + chunk);
+	    if (lo < hi)
+		radixSortItems(data + lo, work + lo, hi - lo);
+	}
+	// Pairwise merges of adjacent runs; std::merge takes from the
+	// left run on ties, which preserves stability:
+	for (R_xlen_t width = chunk; width < n; width *= 2) {
+	    R_xlen_t npairs = (n + 2*width - 1)/(2*width);
+#pragma omp parallel for num_threads(nthreads)
+	    for (R_xlen_t p = 0; p < npairs; ++p) {
+		R_xlen_t lo = 2*width*p;
+		R_xlen_t mid = std::min(n, lo + width);
+		R_xlen_t hi = std::min(n, lo + 2*width);
+		std::merge(data + lo, data + mid, data + mid, data + hi,
+			   work + lo);
+	    }
+	    std::swap(data, work);
+	}
+	if (data != &items[0])
+	    std::copy(data, data + n, &items[0]);
+	return;
+    }
+#endif
+    radixSortItems(data, work, n);
+}
+
+template <typename Key, typename Index, typename KeyFn>
+static void radixOrderBy(Index* indx, R_xlen_t n, KeyFn keyfn)
+{
+    std::vector<RadixItem<Key, Index> > items(n);
+    for (R_xlen_t i = 0; i < n; ++i) {
+	items[i].key = keyfn(indx[i]);
+	items[i].index = indx[i];
+    }
+    radixSort(items);
+    for (R_xlen_t i = 0; i < n; ++i)
+	indx[i] = items[i].index;
+}
+
+// Stably reorders indx[0 .. n-1] (a permutation of 0 ... n-1)
+// according to x, which must satisfy radixOrderable().
+template <typename Index>
+static void radixOrder(Index* indx, R_xlen_t n, SEXP x, Rboolean nalast,
+		       Rboolean decreasing)
+{
+    if (TYPEOF(x) == REALSXP) {
+	const double* rx = REAL(x);
+	radixOrderBy<uint64_t>(indx, n, [=](Index i) {
+		return realRadixKey(rx[i], nalast, decreasing);
+	    });
+    } else {
+	const int* ix = INTEGER(x);
+	radixOrderBy<uint32_t>(indx, n, [=](Index i) {
+		return intRadixKey(ix[i], nalast, decreasing);
+	    });
+    }
+}
+
+// Multi-key version: sorts by the last key first, relying on
+// stability for the earlier keys to take precedence.
+template <typename Index>
+static bool radixOrderList(Index* indx, R_xlen_t n, SEXP keys,
+			   Rboolean nalast, Rboolean decreasing)
+{
+    std::vector<SEXP> keyv;
+    for (SEXP k = keys; k != R_NilValue; k = CDR(k)) {
+	if (!radixOrderable(CAR(k)))
+	    return false;
+	keyv.push_back(CAR(k));
+    }
+    for (size_t k = keyv.size(); k > 0; --k)
+	radixOrder(indx, n, keyv[k - 1], nalast, decreasing);
+    return true;
+}
+
+// Radix sorts the values of an integer, logical or real vector in
+// place.  As with R_isort2(), NA_INTEGER sorts as the smallest
+// integer.
+static void radixSortVector(SEXP s, R_xlen_t n, Rboolean decreasing)
+{
+    std::vector<R_xlen_t> indx(n);
+    for (R_xlen_t i = 0; i < n; ++i)
+	indx[i] = i;
+    radixOrder(&indx[0], n, s, decreasing, decreasing);
+    if (TYPEOF(s) == REALSXP) {
+	double* x = REAL(s);
+	std::vector<double> v(x, x + n);
+	for (R_xlen_t i = 0; i < n; ++i)
+	    x[i] = v[indx[i]];
+    } else {
+	int* x = INTEGER(s);
+	std::vector<int> v(x, x + n);
+	for (R_xlen_t i = 0; i < n; ++i)
+	    x[i] = v[indx[i]];
+    }
+}
+
+static bool anyNaN(const double* x, R_xlen_t n)
+{
+    for (R_xlen_t i = 0; i < n; ++i)
+	if (ISNAN(x[i]))
+	    return true;
+    return false;
+}
+
 /* The meat of sort.int() */
 void sortVector(SEXP s, Rboolean decreasing)
 {
@@ -473,10 +700,14 @@ void sortVector(SEXP s, Rboolean decreasing)
 	switch (TYPEOF(s)) {
 	case LGLSXP:
 	case INTSXP:
-	    R_isort2(INTEGER(s), n, decreasing);
+	    if (n >= R_RADIX_ORDER_MIN)
+		radixSortVector(s, n, decreasing);
+	    else R_isort2(INTEGER(s), n, decreasing);
 	    break;
 	case REALSXP:
-	    R_rsort2(REAL(s), n, decreasing);
+	    if (n >= R_RADIX_ORDER_MIN && !anyNaN(REAL(s), n))
+		radixSortVector(s, n, decreasing);
+	    else R_rsort2(REAL(s), n, decreasing);
 	    break;
 	case CPLXSXP:
 	    R_csort2(COMPLEX(s), n, decreasing);
@@ -976,6 +1207,11 @@ orderVector1(int *indx, int n, SEXP key, Rboolean nalast, Rboolean decreasing,
     StringVector* sv = nullptr /* -Wall */;
 
     if (n < 2) return;
+    if (n >= R_RADIX_ORDER_MIN && radixOrderable(key)
+	&& !(isObject(key) && !isNull(rho))) {
+	radixOrder(indx, n, key, nalast, decreasing);
+	return;
+    }
     switch (TYPEOF(key)) {
     case LGLSXP:
     case INTSXP:
@@ -1114,6 +1350,11 @@ orderVector1l(R_xlen_t *indx, R_xlen_t n, SEXP key, Rboolean nalast,
     R_xlen_t itmp;
 
     if (n < 2) return;
+    if (n >= R_RADIX_ORDER_MIN && radixOrderable(key)
+	&& !(isObject(key) && !isNull(rho))) {
+	radixOrder(indx, n, key, nalast, decreasing);
+	return;
+    }
     switch (TYPEOF(key)) {
     case LGLSXP:
     case INTSXP:
@@ -1291,16 +1532,20 @@ SEXP attribute_hidden do_order(SEXP call, SEXP op, SEXP args, SEXP rho)
 		PROTECT(ans = allocVector(REALSXP, n));
 		R_xlen_t *in = static_cast<R_xlen_t *>( CXXR_alloc(n, sizeof(R_xlen_t)));
 		for (R_xlen_t i = 0; i < n; i++) in[i] = i;
-		orderVectorl(in, n, CAR(args), nalast, decreasing,
-			     listgreaterl);
+		if (!radixOrderList(in, n, args, nalast, decreasing))
+		    orderVectorl(in, n, CAR(args), nalast, decreasing,
+				 listgreaterl);
 		for (R_xlen_t i = 0; i < n; i++) REAL(ans)[i] = in[i] + 1;
 	    } else
 #endif
 	    {
 		PROTECT(ans = allocVector(INTSXP, n));
 		for (R_xlen_t i = 0; i < n; i++) INTEGER(ans)[i] = int( i);
-		orderVector(INTEGER(ans), int( n), args, nalast,
-			    decreasing, listgreater);
+		if (n < R_RADIX_ORDER_MIN
+		    || !radixOrderList(INTEGER(ans), n, args, nalast,
+				       decreasing))
+		    orderVector(INTEGER(ans), int( n), args, nalast,
+				decreasing, listgreater);
 		for (R_xlen_t i = 0; i < n; i++) INTEGER(ans)[i]++;
 	    }
 	}
@@ -1452,8 +1697,27 @@ SEXP attribute_hidden do_radixsort(/*const*/ CXXR::Expression* call, const CXXR:
 	return ans;
     }
 
+    if(double(xmax) - double(xmin) > 100000) {
+	/* Too large a range for counting, so use the general radix
+	   ordering, which has the same treatment of NAs and ties. */
+#ifdef LONG_VECTOR_SUPPORT
+	if (isLong) {
+	    std::vector<R_xlen_t> in(n);
+	    for (i = 0; i < n; i++) in[i] = i;
+	    radixOrder(&in[0], n, x, nalast, decreasing);
+	    for (i = 0; i < n; i++) REAL(ans)[i] = double(in[i] + 1);
+	} else
+#endif
+	{
+	    int *in = INTEGER(ans);
+	    for (i = 0; i < n; i++) in[i] = int(i);
+	    radixOrder(in, n, x, nalast, decreasing);
+	    for (i = 0; i < n; i++) in[i]++;
+	}
+	UNPROTECT(1);
+	return ans;
+    }
     xmax -= xmin;
-    if(xmax > 100000) error(_("too large a range of values in 'x'"));
     napos = off ? 0 : xmax + 1;
     off -= xmin;
     std::vector<unsigned int> cntsv(xmax+2);
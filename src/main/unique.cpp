@@ -36,6 +36,11 @@
 #include "CXXR/ClosureContext.hpp"
 #include "CXXR/DottedArgs.hpp"
 #include "CXXR/RAllocStack.h"
+#include "CXXR/WeakRef.h"
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
 
 using namespace CXXR;
 
@@ -173,17 +178,11 @@ static hlen cshash(SEXP x, R_xlen_t indx, HashData *d)
 
 static hlen shash(SEXP x, R_xlen_t indx, HashData *d)
 {
-    unsigned int k;
-    const char *p;
-    const void *vmax = vmaxget();
     if(!d->useUTF8 && d->useCache) return cshash(x, indx, d);
     /* Not having d->useCache really should not happen anymore. */
-    p = translateCharUTF8(STRING_ELT(x, indx));
-    k = 0;
-    while (*p++)
-	k = 11 * k + static_cast<unsigned int>( *p); /* was 8 but 11 isn't a power of 2 */
-    vmaxset(vmax); /* discard any memory used by translateChar */
-    return scatter(k, d);
+    /* The hash of the UTF-8 text is cached with non-ASCII strings */
+    uint64_t k = SEXP_downcast<const String*>(STRING_ELT(x, indx))->hash();
+    return scatter(static_cast<unsigned int>(k ^ (k >> 32)), d);
 }
 
 static int lequal(SEXP x, R_xlen_t i, SEXP y, R_xlen_t j)
@@ -474,6 +473,329 @@ static void removeEntry(SEXP table, SEXP x, R_xlen_t indx, HashData *d)
     }
 }
 
+/* Cache of hash indexes.
+
+   Hashing a long table dominates the cost of match(x, table) when x
+   is short, so code such as 'x %in% table' inside a loop spends
+   nearly all its time rebuilding the same hash table.  The hash
+   tables of the HASH_INDEX_CACHE_SIZE most recently used long tables
+   are therefore retained, and reused by match(), %in%, duplicated(),
+   unique(), anyDuplicated() and rowsum().
+
+   Only vectors with NAMED == 2 are indexed: R never modifies such a
+   vector in place, so an index cannot go stale.  The table itself is
+   held only via a weak reference, and an index is discarded when its
+   table is garbage collected or when it is displaced from the cache.
+*/
+
+#define HASH_INDEX_CACHE_SIZE 8
+#define HASH_INDEX_MIN_LENGTH 1000
+
+namespace {
+    struct HashIndex {
+	GCRoot<WeakRef> weakref;  // Keyed on the table as supplied.
+	GCRoot<> table;	     // Table after transformation and coercion.
+	GCRoot<> hashtable;  // Protects data.HashTable.
+	SEXPTYPE type;
+	HashData data;
+	bool hasBytes;	     // These two record the encodings of the
+	bool hasKnownEnc;    // elements of a STRSXP table.
+    };
+
+    // In most recently used order:
+    HashIndex s_hash_indexes[HASH_INDEX_CACHE_SIZE];
+}
+
+static SEXP match_transform(SEXP s, SEXP env);
+static int Lookup(SEXP table, SEXP x, R_xlen_t indx, HashData *d);
+
+static bool hashIndexable(SEXP table)
+{
+    if (OBJECT(table) && !inherits(table, "factor"))
+	return false;
+    return MAYBE_SHARED(table)
+	&& XLENGTH(table) >= HASH_INDEX_MIN_LENGTH
+	&& XLENGTH(table) <= INT_MAX
+	&& TYPEOF(table) != VECSXP && TYPEOF(table) != EXPRSXP;
+}
+
+/* Type to which match_transform() converts an indexable table. */
+static SEXPTYPE hashIndexType(SEXP table)
+{
+    return OBJECT(table) ? STRSXP : TYPEOF(table);
+}
+
+static void stringEncodings(SEXP s, bool* hasBytes, bool* hasKnownEnc)
+{
+    *hasBytes = *hasKnownEnc = false;
+    for (R_xlen_t i = 0; i < XLENGTH(s); i++) {
+	SEXP c = STRING_ELT(s, i);
+	if (IS_BYTES(c)) {
+	    *hasBytes = true;
+	    return;
+	}
+	if (ENC_KNOWN(c))
+	    *hasKnownEnc = true;
+    }
+}
+
+static HashIndex* findHashIndex(SEXP table, SEXPTYPE type)
+{
+    for (int k = 0; k < HASH_INDEX_CACHE_SIZE; k++) {
+	HashIndex* index = &s_hash_indexes[k];
+	if (!index->weakref)
+	    continue;
+	RObject* key = index->weakref->key();
+	if (!key) {
+	    // The table has been garbage collected:
+	    index->weakref = nullptr;
+	    index->table = nullptr;
+	    index->hashtable = nullptr;
+	} else if (key == table && index->type == type) {
+	    if (k > 0)
+		std::rotate(s_hash_indexes, s_hash_indexes + k,
+			    s_hash_indexes + k + 1);
+	    return &s_hash_indexes[0];
+	}
+    }
+    return nullptr;
+}
+
+/* Whether strings are hashed via their UTF-8 translations, given the
+   encodings of the elements of x and of the table: as in match5(). */
+static bool hashUTF8(bool xBytes, bool xKnownEnc,
+		     bool tableBytes, bool tableKnownEnc)
+{
+    return !tableBytes && ((!xBytes && xKnownEnc) || tableKnownEnc);
+}
+
+/* Indexes 'table', coerced to 'type', displacing the least recently
+   used index.  xBytes and xKnownEnc describe the strings to be looked
+   up.  If 'dup' is not null, and the table is not transformed, it
+   receives the result of duplicated() on the table as a by-product. */
+static HashIndex* makeHashIndex(SEXP table, SEXPTYPE type, bool xBytes,
+				bool xKnownEnc, SEXP env, int* dup)
+{
+    HashIndex* index = &s_hash_indexes[HASH_INDEX_CACHE_SIZE - 1];
+    index->weakref = nullptr;
+    index->table = nullptr;
+    index->hashtable = nullptr;
+    std::rotate(s_hash_indexes, s_hash_indexes + HASH_INDEX_CACHE_SIZE - 1,
+		s_hash_indexes + HASH_INDEX_CACHE_SIZE);
+    index = &s_hash_indexes[0];
+
+    GCStackRoot<> t(table);
+    if (OBJECT(table) || TYPEOF(table) != type)
+	t = coerceVector(match_transform(table, env), type);
+    index->type = type;
+    index->hasBytes = index->hasKnownEnc = false;
+    if (type == STRSXP)
+	stringEncodings(t, &index->hasBytes, &index->hasKnownEnc);
+    HashData* d = &index->data;
+    HashTableSetup(t, d, NA_INTEGER);
+    index->hashtable = d->HashTable;
+    if (type == STRSXP) {
+	d->useUTF8 = CXXRCONSTRUCT(Rboolean,
+				   hashUTF8(xBytes, xKnownEnc, index->hasBytes,
+					    index->hasKnownEnc));
+	d->useCache = TRUE;
+    }
+    R_xlen_t n = XLENGTH(t);
+    if (t != table)
+	dup = nullptr;
+    for (R_xlen_t i = 0; i < n; i++) {
+	int isdup = isDuplicated(t, i, d);
+	if (dup)
+	    dup[i] = isdup;
+    }
+    if (t != table)
+	index->table = t;
+    index->weakref = new WeakRef(table, nullptr, R_CFinalizer_t(nullptr));
+    return index;
+}
+
+/* Returns the indexed form of the table of 'index', whose key must
+   be 'table'. */
+static SEXP indexedTable(HashIndex* index, SEXP table)
+{
+    return index->table ? SEXP(index->table) : table;
+}
+
+/* Returns the cached index of x as a table for duplicated(), or a null
+   pointer if there is none.  x must be indexable and not an object. */
+static HashIndex* findSelfHashIndex(SEXP x)
+{
+    HashIndex* index = findHashIndex(x, TYPEOF(x));
+    if (index && TYPEOF(x) == STRSXP
+	&& index->data.useUTF8 != (!index->hasBytes && index->hasKnownEnc))
+	return nullptr;
+    return index;
+}
+
+/* duplicated(x) via the cached index of x, indexing x if need be. */
+static SEXP indexedDuplicated(SEXP x)
+{
+    R_xlen_t n = XLENGTH(x);
+    GCStackRoot<> ans(allocVector(LGLSXP, n));
+    int* v = LOGICAL(ans);
+    HashIndex* index = findSelfHashIndex(x);
+    if (!index) {
+	bool hasBytes = false, hasKnownEnc = false;
+	if (TYPEOF(x) == STRSXP)
+	    stringEncodings(x, &hasBytes, &hasKnownEnc);
+	makeHashIndex(x, TYPEOF(x), hasBytes, hasKnownEnc, R_BaseEnv, v);
+	return ans;
+    }
+    HashData data = index->data;
+    data.nomatch = 0;
+    for (R_xlen_t i = 0; i < n; i++)
+	v[i] = (Lookup(x, x, i, &data) != i + 1);
+    return ans;
+}
+
+/* Parallel duplicated() for long integer and real vectors.
+
+   The elements are partitioned on the high bits of a 64-bit hash, so
+   that equal elements fall into the same partition, and the indices
+   within each partition are kept in their original order.  The
+   partitions are then processed independently on worker threads, each
+   with a table sized for that partition only, which gives exactly the
+   result of the serial algorithm, including which occurrence of a
+   value is deemed the first.
+*/
+
+#define R_PARALLEL_HASH_MIN 1000000
+#define HASH_PARTITION_BITS 8
+
+namespace {
+    struct IntKey {
+	static uint64_t hash(int x)
+	{
+	    return uint64_t(uint32_t(x)) * 0x9e3779b97f4a7c15ull;
+	}
+
+	static bool equal(int x, int y)
+	{
+	    return x == y;
+	}
+    };
+
+    struct RealKey {
+	static uint64_t hash(double x)
+	{
+	    /* As rhash(), but using all 64 bits */
+	    if (x == 0.0) x = 0.0;
+	    if (R_IsNA(x)) x = NA_REAL;
+	    else if (R_IsNaN(x)) x = R_NaN;
+	    uint64_t u;
+	    memcpy(&u, &x, sizeof(u));
+	    return (u ^ (u >> 32)) * 0x9e3779b97f4a7c15ull;
+	}
+
+	static bool equal(double x, double y)
+	{
+	    /* As requal() */
+	    if (!ISNAN(x) && !ISNAN(y))
+		return x == y;
+	    else if (R_IsNA(x) && R_IsNA(y)) return true;
+	    else if (R_IsNaN(x) && R_IsNaN(y)) return true;
+	    return false;
+	}
+    };
+}
+
+#ifdef _OPENMP
+template <typename Key, typename T>
+static void partitionedDuplicated(const T* x, int n, bool from_last, int* v,
+				  int nthreads)
+{
+    const int B = HASH_PARTITION_BITS, P = 1 << B;
+    const R_xlen_t chunk = (R_xlen_t(n) + nthreads - 1)/nthreads;
+    std::vector<int> offset(nthreads*P, 0), start(P + 1), indx(n);
+
+#pragma omp parallel for num_threads(nthreads)
+    for (int t = 0; t < nthreads; t++) {
+	int* cnt = &offset[t*P];
+	int begin = int(std::min(R_xlen_t(n), t*chunk));
+	int end = int(std::min(R_xlen_t(n), (t + 1)*chunk));
+	for (int i = begin; i < end; i++)
+	    cnt[Key::hash(x[i]) >> (64 - B)]++;
+    }
+    /* Turn the counts into offsets, ordered by partition and then by
+       thread, so that each partition lists its indices in order. */
+    int pos = 0;
+    for (int p = 0; p < P; p++) {
+	start[p] = pos;
+	for (int t = 0; t < nthreads; t++) {
+	    int c = offset[t*P + p];
+	    offset[t*P + p] = pos;
+	    pos += c;
+	}
+    }
+    start[P] = n;
+#pragma omp parallel for num_threads(nthreads)
+    for (int t = 0; t < nthreads; t++) {
+	int* off = &offset[t*P];
+	int begin = int(std::min(R_xlen_t(n), t*chunk));
+	int end = int(std::min(R_xlen_t(n), (t + 1)*chunk));
+	for (int i = begin; i < end; i++)
+	    indx[off[Key::hash(x[i]) >> (64 - B)]++] = i;
+    }
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+    for (int p = 0; p < P; p++) {
+	int m = start[p + 1] - start[p];
+	if (m == 0)
+	    continue;
+	int K = 1;
+	while ((size_t(1) << K) < 2*size_t(m))
+	    K++;
+	const size_t mask = (size_t(1) << K) - 1;
+	std::vector<int> table(mask + 1, NIL);
+	for (int j = 0; j < m; j++) {
+	    int i = indx[start[p] + (from_last ? m - 1 - j : j)];
+	    size_t h = size_t((Key::hash(x[i]) << B) >> (64 - K));
+	    v[i] = 0;
+	    while (table[h] != NIL) {
+		if (Key::equal(x[table[h]], x[i])) {
+		    v[i] = 1;
+		    break;
+		}
+		h = (h + 1) & mask;
+	    }
+	    if (!v[i])
+		table[h] = i;
+	}
+    }
+}
+#endif
+
+/* Fill v with duplicated(x, fromLast = from_last) using worker
+   threads, returning false (and leaving v alone) if x is too short or
+   of a type not handled, or no threads are available. */
+static bool parallelDuplicated(SEXP x, bool from_last, int* v)
+{
+#ifdef _OPENMP
+    int nthreads = R_num_math_threads > 0 ? R_num_math_threads : 1;
+    R_xlen_t n = XLENGTH(x);
+    if (nthreads < 2 || n < R_PARALLEL_HASH_MIN || n > INT_MAX)
+	return false;
+    switch (TYPEOF(x)) {
+    case INTSXP:
+	partitionedDuplicated<IntKey>(INTEGER(x), int(n), from_last, v,
+				      nthreads);
+	return true;
+    case REALSXP:
+	partitionedDuplicated<RealKey>(REAL(x), int(n), from_last, v,
+				       nthreads);
+	return true;
+    default:
+	break;
+    }
+#endif
+    return false;
+}
+
 #define DUPLICATED_INIT						\
     HashData data;						\
     HashTableSetup(x, &data, nmax);				\
@@ -497,12 +819,15 @@ SEXP duplicated(SEXP x, Rboolean from_last)
 
     if (!isVector(x)) error(_("'duplicated' applies only to vectors"));
     R_xlen_t i, n = XLENGTH(x);
+    PROTECT(ans = allocVector(LGLSXP, n));
+    v = LOGICAL(ans);
+    if (parallelDuplicated(x, from_last, v)) {
+	UNPROTECT(1);
+	return ans;
+    }
     DUPLICATED_INIT;
 
     PROTECT(data.HashTable);
-    PROTECT(ans = allocVector(LGLSXP, n));
-
-    v = LOGICAL(ans);
 
     if(from_last)
 	for (i = n-1; i >= 0; i--) {
@@ -526,6 +851,16 @@ static SEXP Duplicated(SEXP x, Rboolean from_last, int nmax)
 
     if (!isVector(x)) error(_("'duplicated' applies only to vectors"));
     R_xlen_t i, n = XLENGTH(x);
+    if (nmax == NA_INTEGER && n >= R_PARALLEL_HASH_MIN) {
+	PROTECT(ans = allocVector(LGLSXP, n));
+	if (parallelDuplicated(x, from_last, LOGICAL(ans))) {
+	    UNPROTECT(1);
+	    return ans;
+	}
+	UNPROTECT(1);
+    }
+    if (!from_last && nmax == NA_INTEGER && !OBJECT(x) && hashIndexable(x))
+	return indexedDuplicated(x);
     DUPLICATED_INIT;
 
     PROTECT(data.HashTable);
@@ -557,6 +892,31 @@ R_xlen_t any_duplicated(SEXP x, Rboolean from_last)
     if (!isVector(x)) error(_("'duplicated' applies only to vectors"));
     R_xlen_t i, n = XLENGTH(x);
 
+    if (!from_last && !OBJECT(x) && hashIndexable(x)) {
+	HashIndex* index = findSelfHashIndex(x);
+	if (index) {
+	    HashData data = index->data;
+	    data.nomatch = 0;
+	    for (i = 0; i < n; i++)
+		if (Lookup(x, x, i, &data) != i + 1)
+		    return i + 1;
+	    return 0;
+	}
+    }
+    if (n >= R_PARALLEL_HASH_MIN) {
+	std::vector<int> v(n);
+	if (parallelDuplicated(x, from_last, &v[0])) {
+	    if (from_last) {
+		for (i = n-1; i >= 0; i--)
+		    if (v[i]) return i + 1;
+	    } else {
+		for (i = 0; i < n; i++)
+		    if (v[i]) return i + 1;
+	    }
+	    return 0;
+	}
+    }
+
     DUPLICATED_INIT;
     PROTECT(data.HashTable);
 
@@ -832,6 +1192,29 @@ static SEXP match_transform(SEXP s, SEXP env)
     return duplicate(s);
 }
 
+/* match5() using the cached index of the table. */
+static SEXP indexedMatch(SEXP itable, SEXP ix, int nmatch, SEXP env)
+{
+    SEXPTYPE ttype = hashIndexType(itable), type;
+    GCStackRoot<> x(match_transform(ix, env));
+    if(TYPEOF(x) >= STRSXP || ttype >= STRSXP) type = STRSXP;
+    else type = TYPEOF(x) < ttype ? ttype : TYPEOF(x);
+    x = coerceVector(x, type);
+    bool xBytes = false, xKnownEnc = false;
+    if (type == STRSXP)
+	stringEncodings(x, &xBytes, &xKnownEnc);
+    HashIndex* index = findHashIndex(itable, type);
+    if (index && type == STRSXP
+	&& index->data.useUTF8 != hashUTF8(xBytes, xKnownEnc, index->hasBytes,
+					   index->hasKnownEnc))
+	index = nullptr;
+    if (!index)
+	index = makeHashIndex(itable, type, xBytes, xKnownEnc, env, nullptr);
+    HashData data = index->data;
+    data.nomatch = nmatch;
+    return HashLookup(indexedTable(index, itable), x, &data);
+}
+
 /* currently used by fastmatch */
 SEXP match5(SEXP itable, SEXP ix, int nmatch, SEXP incomp, SEXP env)
 {
@@ -849,6 +1232,9 @@ SEXP match5(SEXP itable, SEXP ix, int nmatch, SEXP incomp, SEXP env)
 	return ans;
     }
 
+    if (!incomp && hashIndexable(itable))
+	return indexedMatch(itable, ix, nmatch, env);
+
     int nprot = 0;
     PROTECT(x	  = match_transform(ix,	    env)); nprot++;
     PROTECT(table = match_transform(itable, env)); nprot++;
@@ -1379,8 +1765,6 @@ rowsum(SEXP x, SEXP g, SEXP uniqueg, SEXP snarm, SEXP rn)
     SEXP matches,ans;
     int n, p, ng, narm;
     R_xlen_t offset = 0, offsetg = 0;
-    HashData data;
-    data.nomatch = 0;
 
     n = LENGTH(g);
     ng = Rf_length(uniqueg);
@@ -1388,10 +1772,7 @@ rowsum(SEXP x, SEXP g, SEXP uniqueg, SEXP snarm, SEXP rn)
     if(narm == NA_LOGICAL) error("'na.rm' must be TRUE or FALSE");
     if(isMatrix(x)) p = ncols(x); else p = 1;
 
-    HashTableSetup(uniqueg, &data, NA_INTEGER);
-    PROTECT(data.HashTable);
-    DoHashing(uniqueg, &data);
-    PROTECT(matches = HashLookup(uniqueg, g, &data));
+    PROTECT(matches = match5(uniqueg, g, 0, nullptr, R_BaseEnv));
 
     PROTECT(ans = allocMatrix(TYPEOF(x), ng, p));
 
@@ -1442,7 +1823,7 @@ rowsum(SEXP x, SEXP g, SEXP uniqueg, SEXP snarm, SEXP rn)
     if(Rf_length(dn2 = getAttrib(x, R_DimNamesSymbol)) >= 2 &&
        !isNull(dn3 = VECTOR_ELT(dn2, 1))) SET_VECTOR_ELT(dn, 1, dn3);
 
-    UNPROTECT(3); /* HashTable, matches, ans */
+    UNPROTECT(2); /* matches, ans */
     return ans;
 }
 
@@ -1451,8 +1832,6 @@ rowsum_df(SEXP x, SEXP g, SEXP uniqueg, SEXP snarm, SEXP rn)
 {
     SEXP matches,ans,col,xcol;
     int p, narm;
-    HashData data;
-    data.nomatch = 0;
 
     R_xlen_t n = XLENGTH(g);
     p = LENGTH(x);
@@ -1460,10 +1839,7 @@ rowsum_df(SEXP x, SEXP g, SEXP uniqueg, SEXP snarm, SEXP rn)
     narm = asLogical(snarm);
     if(narm == NA_LOGICAL) error("'na.rm' must be TRUE or FALSE");
 
-    HashTableSetup(uniqueg, &data, NA_INTEGER);
-    PROTECT(data.HashTable);
-    DoHashing(uniqueg, &data);
-    PROTECT(matches = HashLookup(uniqueg, g, &data));
+    PROTECT(matches = match5(uniqueg, g, 0, nullptr, R_BaseEnv));
 
     PROTECT(ans = allocVector(VECSXP, p));
 
@@ -1511,7 +1887,7 @@ rowsum_df(SEXP x, SEXP g, SEXP uniqueg, SEXP snarm, SEXP rn)
     setAttrib(ans, R_RowNamesSymbol, rn);
     classgets(ans, mkString("data.frame"));
 
-    UNPROTECT(3); /* HashTable, matches, ans */
+    UNPROTECT(2); /* matches, ans */
     return ans;
 }
 
@@ -33,6 +33,7 @@
 #include <R_ext/Print.h>
 #include "basedecl.h"
 
+#include <algorithm>
 #include <vector>
 #include "CXXR/BuiltInFunction.h"
 #include "CXXR/ClosureContext.hpp"
@@ -2163,6 +2164,9 @@ SEXP attribute_hidden do_bincode(/*const*/ CXXR::Expression* call, const CXXR::B
     return codes;
 }
 
+/* Minimum length for tabulate() to count on several threads */
+#define R_PARALLEL_TABULATE_MIN 1000000
+
 SEXP attribute_hidden do_tabulate(/*const*/ CXXR::Expression* call, const CXXR::BuiltInFunction* op, CXXR::Environment* rho, CXXR::RObject* const* args, int num_args, const CXXR::PairList* tags)
 {
     op->checkNumArgs(num_args, call);
@@ -2176,6 +2180,31 @@ SEXP attribute_hidden do_tabulate(/*const*/ CXXR::Expression* call, const CXXR::
     SEXP ans = allocVector(INTSXP, nb);
     int *x = INTEGER(in), *y = INTEGER(ans);
     memset(y, 0, nb * sizeof(int));
+#ifdef _OPENMP
+    /* Long inputs are counted in chunks, one private set of bins per
+       thread, which are then summed.  Not worth it unless there are
+       many more elements than bins. */
+    int nthreads = R_num_math_threads > 0 ? R_num_math_threads : 1;
+    if (nthreads > 1 && n >= R_PARALLEL_TABULATE_MIN
+	&& R_xlen_t(nb) * nthreads <= n) {
+	std::vector<int> counts(size_t(nb) * nthreads, 0);
+	R_xlen_t chunk = (n + nthreads - 1)/nthreads;
+#pragma omp parallel for num_threads(nthreads)
+	for (int t = 0; t < nthreads; t++) {
+	    int* cnt = &counts[size_t(nb) * t];
+	    R_xlen_t end = std::min(n, (t + 1) * chunk);
+	    for (R_xlen_t i = t * chunk; i < end; i++)
+		if (x[i] != NA_INTEGER && x[i] > 0 && x[i] <= nb)
+		    cnt[x[i] - 1]++;
+	}
+	for (int t = 0; t < nthreads; t++) {
+	    const int* cnt = &counts[size_t(nb) * t];
+	    for (int j = 0; j < nb; j++)
+		y[j] += cnt[j];
+	}
+	return ans;
+    }
+#endif
     for(R_xlen_t i = 0 ; i < n ; i++)
 	if (x[i] != NA_INTEGER && x[i] > 0 && x[i] <= nb) y[x[i] - 1]++;
     return ans;